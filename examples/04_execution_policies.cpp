@@ -11,8 +11,19 @@
 //
 // The currently supported policies are:
 //  - tdp::policy::queue - Uses a blocking queue to store the values between threads
+//  - tdp::policy::bounded_queue<Capacity> - Uses a blocking queue, waiting when it's full
 //  - tdp::policy::triple_buffer - Uses a blocking triple-buffer to store values
 //  - tdp::policy::triple_buffer_lockfree - Uses a lock-free triple-buffer
+//  - tdp::policy::spsc_ring<Capacity> - Uses a bounded lock-free queue, waiting when it's full
+//  - tdp::policy::spsc_unbounded - Uses an unbounded lock-free queue
+//
+// Each policy can also select how a stage waits for data, with Policy.with<Strategy>:
+//  - tdp::wait::park - Sleeps until data arrives (default)
+//  - tdp::wait::yield - Keeps checking, yielding to other threads in between
+//  - tdp::wait::busy_poll - Keeps checking, for the lowest latency on dedicated cores
+//
+// A single edge can use another policy, with tdp::via(Policy) before the stage it feeds:
+//  tdp::input<int> >> tdp::via(tdp::policy::queue) >> stage >> tdp::via(tdp::policy::triple_buffer) >> ...
 //
 // This tutorial shows the difference between these policies and how to use them in a pipeline.
 //---------------------------------------------------------------------------------------------------------------------
@@ -52,6 +52,14 @@ namespace tdp {
 //     Describes an user input.
 //     Input must be provided by calling pipeline.input(args...)
 //
+//     A sequence of inputs can be provided at once, with a single queue operation:
+//       pipeline.input_range(first, last); // Elements must be convertible to std::tuple<Args...>
+//       pipeline.input_range({{"Hello", 5}, {"World", 6}});
+//
+//     When the pipeline uses a bounded policy, input(args...) waits while the first stage is full.
+//     To avoid waiting, use pipeline.try_input(args...) or pipeline.input_for(timeout, args...),
+//     which return false when the input was rejected.
+//
 //     Example:
 //       auto combine = [](std::string s, int x){ return s + ": " + std::to_string(x); };
 //       auto pipeline = tdp::input<std::string, int> >> combine >> tdp::output;
@@ -67,6 +75,17 @@ namespace tdp {
 //     A pipeline created with a producer doesn't have the input(args...) member function.
 //     Instead, it provides pause(), resume() and producing() in its interface.
 //
+// tdp::producers{ function1, function2, ... }
+//
+//     Describes many sources feeding the same stages, e.g. one per capture device.
+//     Each function runs on its own thread, as a producer would, and must return the same type.
+//     Their outputs are merged into the first edge, which uses the concurrent form of the policy.
+//     The order between outputs of different functions is the order in which they were produced.
+//     pause() and resume() apply to all of them.
+//
+//     Example:
+//       auto pipeline = tdp::producers{camera_a, camera_b, camera_c} >> detect >> tdp::consumer{report};
+//
 //-------------------------------------------------------------------------------------------------
 
 template <typename... InputArgs>
@@ -74,6 +93,8 @@ inline constexpr detail::input_type<InputArgs...> input = {};
 
 using detail::producer;
 
+using detail::producers;
+
 //-------------------------------------------------------------------------------------------------
 // Output Types
 //
@@ -90,6 +111,12 @@ using detail::producer;
 //     pipeline.input(5); // Provides an input for the pipeline
 //     auto res = pipeline.wait_get(); // Gets the result, equivalent to calling square(5)
 //
+// Polled outputs can also be retrieved in bulk, each with a single queue operation:
+//
+//     auto batch = pipeline.wait_get_n(10);                 // Waits for 10 outputs, in an std::vector
+//     auto count = pipeline.try_get_up_to(10, out);         // Writes up to 10 available outputs to 'out'
+//     auto end = pipeline.drain_to(std::back_inserter(v));  // Writes all available outputs to 'out'
+//
 // Example 2: Using a consumer/sink thread
 //
 //     auto print = [](auto x){ std::cout << x << std::endl; };
@@ -98,6 +125,26 @@ using detail::producer;
 //     pipeline.input(5);
 //         // the value of square(5) will be automatically printed
 //
+// Example 3: Broadcasting to many consumers
+//
+//     auto pipeline = tdp::input<frame> >> encode >> tdp::broadcast{write_to_disk, send, update_metrics};
+//
+// Each consumer runs on its own thread, and gets every output, in order.
+// An output is stored once, shared by all consumers, which are called with a const reference to it.
+// Each consumer reads its own queue, so a slow one only holds the others back once its queue is full.
+// It's the same as tdp::consumer{tdp::fork{consumers...}}: see the "Forks" section below.
+//
+// Example 4: Linking to another pipeline
+//
+//     auto decoder = tdp::input<packet> >> decode >> tdp::output / tdp::as_shared_ptr;
+//     auto receiver = tdp::producer{receive} >> tdp::into(decoder);
+//
+// The last stage pushes its outputs straight to the input of the linked pipeline, without a consumer in between.
+// Each pipeline keeps its own policy and executor. The linked one must be a std::shared_ptr, e.g. from
+// tdp::as_shared_ptr, and is kept alive by the pipelines linked to it, so it can be shared by many of them.
+// As many pipelines and replicas can push to it, its input policy must accept many producers: it can't be SPSC.
+// The outputs must be the input type, or a std::tuple of the input types for many arguments.
+//
 //-------------------------------------------------------------------------------------------------
 
 /// Determines the end of the pipeline, indicating the output should be polled.
@@ -110,6 +157,239 @@ inline constexpr detail::end_type output = {};
 /// Return type of 'function' must be void.
 using detail::consumer;
 
+/// Many consumer outputs, each on its own thread, sharing every output without copies.
+/// Usage: ... >> tdp::broadcast{ function1, function2, ... };
+using detail::broadcast;
+
+/// Sends the outputs to the input of another pipeline, created with tdp::as_shared_ptr.
+/// Usage: ... >> tdp::into(pipeline);
+using detail::into;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Parallel Stages
+//
+// By default, each stage runs on a single thread.
+// A stage that is much slower than the others can be run by many threads, with tdp::parallel<N>:
+//
+//     auto pipeline = tdp::input<frame> >> tdp::parallel<4>(decode) >> encode >> tdp::output;
+//
+// Each thread gets its own copy of the stage, and takes one input at a time.
+// Outputs are provided as soon as they're done, so they may be out of order.
+//
+// The edges around a parallel stage are shared by many threads.
+// A lock-free policy is replaced by its blocking equivalent on them (e.g. spsc_ring by bounded_queue).
+//
+// When the order matters, use tdp::ordered_parallel<N>:
+//
+//     auto pipeline = tdp::input<frame> >> tdp::ordered_parallel<4>(encode) >> tdp::consumer{write};
+//
+// Inputs are numbered as they're taken, and each output waits in a reorder buffer until the previous ones are sent.
+// A thread that gets too far ahead of the oldest unfinished input waits.
+// The buffer size can be set as tdp::ordered_parallel<N, Window>, and must be at least N. The default is 2 * N.
+// An ordered stage takes from and writes to its edges one thread at a time, so it keeps the pipeline's policy.
+//
+// Stages with per-key state, e.g. one decoder per session, can be split by key with tdp::partition<N>:
+//
+//     auto session_of = [](const packet& p) { return p.session_id; };
+//     auto pipeline = tdp::input<packet> >> tdp::partition<4>(session_of, decode) >> tdp::output;
+//
+// The edge before the stage holds one queue per thread. Each input goes to queue std::hash(key) % N,
+// so all inputs with the same key are processed in order, by the same copy of the stage.
+// The key function is called with the stage's input, and must return a type supported by std::hash.
+// As each queue has a single reader, a partitioned stage keeps lock-free policies on its input.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Runs a stage on Replicas threads. Usage: ... >> tdp::parallel<4>(function) >> ...
+using detail::parallel;
+
+/// Runs a stage on Replicas threads, keeping the input order. Usage: ... >> tdp::ordered_parallel<4>(function) >> ...
+using detail::ordered_parallel;
+
+/// Runs a stage on Replicas threads, sending equal keys to the same thread. Usage: tdp::partition<4>(key, function)
+using detail::partition;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Fused Stages
+//
+// Each stage runs on its own thread, and hands its output to the next one through a queue.
+// For cheap stages, that hand-off costs more than the work itself.
+// tdp::fuse{f, g, h} chains functions into a single stage, with no queue between them:
+//
+//     auto pipeline = tdp::input<std::string> >> tdp::fuse{parse, to_celsius, round} >> tdp::consumer{log};
+//
+// The fused stage calls h(g(f(args...))), passing each result directly to the next function.
+// It's a stage like any other: it can be a producer or consumer, or run by many threads with tdp::parallel.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Chains functions into a single stage. Usage: ... >> tdp::fuse{f, g, h} >> ...
+using detail::fuse;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Filter Stages
+//
+// A stage can drop inputs, sending nothing to the next stage, with tdp::filter:
+//
+//     auto is_valid = [](const packet& p) { return p.checksum_ok(); };
+//     auto pipeline = tdp::input<packet> >> tdp::filter{is_valid} >> decode >> tdp::output;
+//
+// The predicate is called with a const reference to each input, which is sent unchanged when it returns true.
+// Stages that compute their output and decide whether to keep it at once can return a std::optional,
+// wrapped in tdp::filter_map. Only engaged values are sent, unwrapped:
+//
+//     auto parse = [](const std::string& s) -> std::optional<int> { ... };
+//     auto pipeline = tdp::input<std::string> >> tdp::filter_map{parse} >> square >> tdp::output;
+//
+// Dropped inputs never reach the next queue, so they cost nothing downstream.
+// Filters can be parallel, partitioned, fused (as the last function) and producers, but not ordered.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Only sends the inputs for which a predicate returns true. Usage: ... >> tdp::filter{predicate} >> ...
+using detail::filter;
+
+/// Sends the value of each engaged std::optional returned by a function. Usage: ... >> tdp::filter_map{f} >> ...
+using detail::filter_map;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Flat-Map Stages
+//
+// A stage can send many outputs per input, e.g. splitting packets into messages, with tdp::flat_map:
+//
+//     auto split = [](const packet& p) { return p.messages(); }; // Returns a std::vector<message>
+//     auto pipeline = tdp::input<packet> >> tdp::flat_map{split} >> handle >> tdp::output;
+//
+// The function returns a range, and each of its elements is moved to the next stage on its own,
+// which starts working on the first one while the others are still being sent. An empty range sends nothing.
+// Like filters, flat-map stages can be parallel, partitioned, fused (as the last function) and producers,
+// but not ordered.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Sends each element of the range returned by a function. Usage: ... >> tdp::flat_map{f} >> ...
+using detail::flat_map;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Batching
+//
+// Stages that work faster on many inputs at once can get them in batches, collected by tdp::batch<N>:
+//
+//     auto pipeline = tdp::input<image> >> tdp::batch<32>(5ms) >> infer >> tdp::unbatch >> tdp::output;
+//
+// The batch stage sends a std::vector of up to N inputs, in order, to the next stage.
+// A batch is sent once it's full, or once its first input has waited for the maximum delay (5ms, above).
+// The delay is kept by the stage's own thread, which waits for more input only until then.
+// On the work-stealing executor, stages never wait: a batch is also sent when the stage runs out of input.
+//
+// tdp::unbatch does the opposite, sending each element of a batch (or any range) to the next stage.
+// A batch stage runs on a single thread: it can't be parallel, partitioned, ordered, fused or part of a fork.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Collects up to Size inputs into a std::vector, waiting at most max_delay. Usage: ... >> tdp::batch<16>(1ms) >> ...
+using detail::batch;
+
+/// Sends each element of a batch to the next stage. Usage: ... >> tdp::unbatch >> ...
+inline constexpr detail::unbatch_stage unbatch = {};
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Forks
+//
+// A stage can run independent branches on the same input, each on its own thread, with tdp::fork:
+//
+//     auto pipeline = tdp::input<frame> >> tdp::fork{detect_faces, read_text, histogram} >> tdp::consumer{report};
+//
+// Every branch gets every input. The input is stored once, and each branch is called with a const reference to it.
+// The next stage gets a std::tuple with the result of each branch, in the order of the branches,
+// and the tuples keep the order of the inputs.
+// When no branch returns a value, the fork is a consumer: tdp::consumer{tdp::fork{save, display}}.
+//
+// The edge before the fork holds one queue per branch, which can keep the lock-free policies.
+// A branch can get ahead of the slowest one by as many inputs as its queue holds.
+// try_input() and input_for() only take an input when every branch has room for it.
+// Triple buffers would drop different inputs on each branch, so under tdp::policy::triple_buffer and
+// tdp::policy::triple_buffer_lockfree the branches read unbounded queues instead.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Runs each branch on its own thread, with the same input, then joins their results in a tuple.
+using detail::fork;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Routes
+//
+// Inputs of different kinds can be processed by different stages, each on its own thread, with tdp::route:
+//
+//     auto kind = [](const message& m) { return m.kind(); }; // 0 for text, 1 for images, 2 for anything else
+//     auto pipeline = tdp::input<message> >> tdp::route{kind, handle_text, handle_image, handle_other} >> tdp::output;
+//
+// The selector is called with a const reference to each input, and returns the index of the branch to send it to.
+// Indexes past the last branch send it to the last one, which can be used as a default. So do negative indexes.
+// With std::variant inputs, the selector can be [](const auto& v) { return v.index(); }.
+//
+// The edge before the route holds one queue per branch, which can keep the lock-free policies.
+// A slow branch only delays the inputs sent to it: the others keep going, as long as the route's input isn't full.
+// Each branch runs on a single thread. Branches made of many functions can be chained with tdp::fuse.
+//
+// All branches must return the same type. Their results are merged into the next edge as they're done,
+// so inputs sent to different branches may leave out of order. When no branch returns a value,
+// the route is a consumer: tdp::consumer{tdp::route{kind, save_text, save_image}}.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Sends each input to the branch picked by a selector, each running on its own thread.
+/// Usage: ... >> tdp::route{selector, branch0, branch1, ...} >> ...
+using detail::route;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Taps
+//
+// The outputs of a stage can be watched, e.g. for a dashboard, without slowing the pipeline, with tdp::tap:
+//
+//     auto pipeline = tdp::input<frame> >> decode >> tdp::tap{show_preview} >> detect >> tdp::output;
+//
+// The observer runs on its own thread, and is called with copies of the outputs of the stage before the tap.
+// Each replica of the stage hands them over through a triple buffer of its own, which never waits nor wakes anyone:
+// when the observer is busy, only the latest output is kept for it, and the others are missed.
+// The observer polls the buffers, backing off to a millisecond between checks while they stay empty.
+// On a task executor, it's scheduled instead, when a buffer it had emptied gets an output.
+// Copying every output can be expensive, so a tap can only offer one in N: tdp::tap{show_preview, 30}.
+// The outputs skipped that way cost the stage nothing.
+//
+// The observed outputs must be default constructible and copyable, and the observer must return void.
+// A tap must follow a stage, which can't be a fork, and precede tdp::via().
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Offers copies of the outputs of the previous stage to an observer, on its own thread, skipping any it misses.
+/// Usage: ... >> stage >> tdp::tap{observer} >> ... or, offering one in N outputs, tdp::tap{observer, N}
+using detail::tap;
+
 }  // namespace tdp
 
 //-------------------------------------------------------------------------------------------------
@@ -128,6 +408,12 @@ using detail::consumer;
 //    // Use a producer and triple-buffering:
 //    auto pipeline = tdp::producer{ function }
 //                    >> functions... >> tdp::output / tdp::policy::triple_buffer;
+//
+// Every policy can be combined with a wait strategy, with the syntax Policy.with<Strategy>.
+// See the "Wait Strategies" section below.
+//
+// The policy of a pipeline can be checked at compile time, with tdp::uses_policy_v:
+//    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::triple_buffer>);
 //-------------------------------------------------------------------------------------------------
 
 namespace tdp::policy {
@@ -138,6 +424,7 @@ inline constexpr detail::policy_type<util::blocking_triple_buffer> triple_buffer
 
 /// A lock-free implementation of the triple buffer policy
 /// Better used when the producer is faster than the pipeline stages, i.e. there's no wait.
+/// Idle stages spin for a short while, then sleep until new data arrives.
 inline constexpr detail::policy_type<util::lock_free_triple_buffer> triple_buffer_lockfree = {};
 
 /// Queue, with "unlimited" storage.
@@ -145,8 +432,146 @@ inline constexpr detail::policy_type<util::lock_free_triple_buffer> triple_buffe
 /// Beware of unbalanced pipelines, they can cause high memory usage.
 inline constexpr detail::policy_type<util::blocking_queue> queue = {};
 
+/// Blocking queue, holding at most Capacity elements per stage.
+/// A stage with a full output waits for the next one, so producers slow down to the bottleneck's rate.
+/// Better for cases where no input can be missed, but memory must be bounded.
+template <std::size_t Capacity>
+inline constexpr detail::policy_type<detail::bounded_policy<util::bounded_blocking_queue, Capacity>::template queue_t>
+    bounded_queue = {};
+
+/// Lock-free single-producer single-consumer ring buffer, holding at most Capacity elements per stage.
+/// Capacity must be a power of two. No input is missed: a stage with a full output waits for the next one.
+/// Better for cases where no input can be missed, but memory must be bounded.
+template <std::size_t Capacity>
+inline constexpr detail::policy_type<detail::bounded_policy<util::lock_free_ring_buffer, Capacity>::template queue_t>
+    spsc_ring = {};
+
+/// Lock-free single-producer single-consumer queue, with "unlimited" storage.
+/// Storage grows in fixed-size segments, which are reused once drained.
+/// Like the queue policy, beware of unbalanced pipelines.
+inline constexpr detail::policy_type<util::lock_free_segmented_queue> spsc_unbounded = {};
+
 };  // namespace tdp::policy
 
+namespace tdp {
+
+/// Whether a pipeline, or a smart pointer wrapping one, was built with the given policy.
+/// Usage: tdp::uses_policy_v<decltype(pipeline), tdp::policy::queue>
+template <typename Pipeline, const auto& Policy>
+inline constexpr bool uses_policy_v =
+    detail::uses_policy<std::remove_cv_t<Pipeline>, std::remove_cv_t<std::remove_reference_t<decltype(Policy)>>>::value;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Wait Strategies
+//
+// A wait strategy determines what a stage does while its input is empty, or its output is full.
+// When not specified, the default is tdp::wait::park.
+//
+// The syntax is:
+//   Input >> ... >> Output / Policy.with<Strategy>
+//
+// Examples:
+//    // A latency-critical pipeline, on dedicated cores:
+//    auto pipeline = tdp::input<int> >> functions... >> tdp::output / tdp::policy::queue.with<tdp::wait::busy_poll>;
+//
+//    // A background pipeline, using the lock-free triple buffer:
+//    auto pipeline = tdp::input<int> >> functions...
+//                    >> tdp::output / tdp::policy::triple_buffer_lockfree.with<tdp::wait::park>;
+//
+// The strategy also determines how often a waiting stage checks whether the pipeline is stopping.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp::wait {
+
+/// Sleeps until notified. Lock-free policies spin for a short while before sleeping.
+/// Better for pipelines that are idle most of the time, or that share cores with other work.
+using park = util::hybrid_park;
+
+/// Checks again after yielding to the OS scheduler. The waiting thread never sleeps.
+using yield = util::yield_wait;
+
+/// Checks again in a tight loop. The lowest latency, but each waiting stage keeps a core busy.
+/// Better used with dedicated cores.
+using busy_poll = util::busy_poll_wait;
+
+}  // namespace tdp::wait
+
+//-------------------------------------------------------------------------------------------------
+// Per-Edge Policies
+//
+// The policy of a single edge can be replaced, placing tdp::via(Policy) before the stage it feeds.
+// All other edges keep the pipeline's policy.
+//
+// The syntax is:
+//   Input >> ... >> tdp::via(Policy) >> stage >> ... >> Output
+//
+// Example:
+//    // A lossless queue out of the decoder, and a triple buffer in front of the renderer:
+//    auto pipeline = tdp::producer{ decode } >> tdp::via(tdp::policy::spsc_ring<64>) >> filter
+//                    >> tdp::via(tdp::policy::triple_buffer) >> tdp::consumer{ render };
+//
+// A tdp::via() right after tdp::input selects the policy of the input.
+// The output's policy is still selected with Output / Policy.
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// Selects the policy of the edge feeding the next stage. Usage: ... >> tdp::via(tdp::policy::queue) >> stage
+using detail::via;
+
+}  // namespace tdp
+
+//-------------------------------------------------------------------------------------------------
+// Executors
+//
+// By default, each stage runs on its own thread, or threads for parallel stages.
+// An executor can run the stages on a fixed pool of threads instead, which is useful for long pipelines.
+//
+// The syntax is:
+//   Input >> ... >> Output / Executor
+//   Input >> ... >> Output / Policy / Executor
+//   Input >> ... >> Output / Policy / Executor / Wrapper
+//
+// Example:
+//    // A 20-stage pipeline, running on 4 threads:
+//    auto pipeline = tdp::input<int> >> stages... >> tdp::output / tdp::executor::work_stealing(4);
+//
+// With tdp::executor::work_stealing(n), each thread of the pool has its own queue of stages ready to run,
+// and takes stages from the others when its queue is empty. A stage is only run when its input has data.
+// Instead of waiting for a full output, a stage is put aside until another stage makes progress.
+// A thread count of 0 uses one thread per hardware thread.
+//
+// Many pipelines can also share the threads of a tdp::scheduler, with tdp::executor::on(scheduler).
+// Constructing such a pipeline creates no threads, and ready stages of all pipelines take turns on the scheduler.
+// The scheduler must outlive its pipelines, and a pipeline must not be destroyed by a stage running on its scheduler.
+//
+// Example:
+//    tdp::scheduler scheduler{8};
+//    std::vector<std::unique_ptr<...>> feeds;
+//    for (auto& camera : cameras)
+//      feeds.push_back(tdp::producer{camera} >> detect >> tdp::consumer{report}
+//                      / tdp::executor::on(scheduler) / tdp::as_unique_ptr);
+//-------------------------------------------------------------------------------------------------
+
+namespace tdp {
+
+/// A pool of 'threads' threads, shared by the pipelines registered with it. 0 means one per hardware thread.
+using detail::scheduler;
+
+}  // namespace tdp
+
+namespace tdp::executor {
+
+/// Runs the pipeline's stages as tasks on a pool of 'threads' threads, owned by the pipeline.
+using detail::work_stealing;
+
+/// Runs the pipeline's stages as tasks on the threads of a scheduler.
+using detail::on;
+
+}  // namespace tdp::executor
+
 //-------------------------------------------------------------------------------------------------
 // Smart Pointer Wrappers
 //
@@ -8,134 +8,734 @@
 #ifndef TDP_PIPELINE_IMPL_HPP
 #define TDP_PIPELINE_IMPL_HPP
 
+#include <algorithm>
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <deque>
 #include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 #include <thread>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "util/blocking_queue.hpp"
 #include "util/blocking_triple_buffer.hpp"
+#include "util/bounded_blocking_queue.hpp"
+#include "util/broadcast_queue.hpp"
 #include "util/helpers.hpp"
+#include "util/latest_slots.hpp"
+#include "util/lock_free_ring_buffer.hpp"
+#include "util/lock_free_segmented_queue.hpp"
 #include "util/lock_free_triple_buffer.hpp"
+#include "util/partitioned_queue.hpp"
 #include "util/type_list.hpp"
+#include "util/wait_strategies.hpp"
+#include "util/work_stealing_pool.hpp"
 
 namespace tdp::detail {
 
 //-------------------------------------------------------------------------------------------------
 // Processing threads
+//
+// Stages with an input take every available element in one call to drain_into(),
+// then process the batch before touching the queue again.
+//
+// InputQueue and OutputQueue are references to the queues, or adapters holding them.
+// They are void for the missing side of producers and consumers.
+//
+// Each worker does its work in steps. A step waits for input or output space until p() holds:
+// the thread executor passes the stop condition, and loops over steps until the pipeline stops.
+// The work-stealing executor passes a condition that always holds, so steps never wait.
+// An output that can't be sent before p() holds is kept by the worker, and sent first on the next step.
 //-------------------------------------------------------------------------------------------------
 
-template <template <typename...> class Queue, typename Input, typename Callable, typename = void, typename = void>
+// What a step did: whether it moved any element, and whether it was left with an element it couldn't send
+struct step_result {
+  bool progressed;
+  bool blocked;
+};
+
+// Writers that keep elements of their own, like the reorder buffer of ordered stages, send them before each step.
+// A writer still holding elements after a step leaves its worker blocked.
+template <typename Writer, typename Pred, typename = void>
+struct has_flush : std::false_type {};
+
+template <typename Writer, typename Pred>
+struct has_flush<Writer, Pred, std::void_t<decltype(std::declval<Writer&>().flush(std::declval<Pred&>()))>>
+    : std::true_type {};
+
+template <typename Writer, typename Pred>
+bool flush_output([[maybe_unused]] Writer& writer, [[maybe_unused]] Pred& p) {
+  if constexpr (has_flush<Writer, Pred>::value)
+    return writer.flush(p);
+  else
+    return true;
+}
+
+// Sends the outputs kept from previous steps. Returns whether all of them were sent, setting 'progressed' if any was.
+template <typename Worker, typename Pred>
+bool send_pending(Worker& w, Pred& p, bool& progressed) {
+  for (; !w._pending.empty(); w._pending.pop_front()) {
+    if (!w._output_queue.push_unless(std::move(w._pending.front()), p))
+      return false;
+    progressed = true;
+  }
+  return true;
+}
+
+// Sends the outputs of a call to the stage, keeping those that can't be sent before p() holds.
+// Stages that emit many, like filters, can have any number of outputs per call. Returns whether all were sent.
+template <typename Worker, typename Result, typename Pred>
+bool send_outputs(Worker& w, Result&& res, Pred& p) {
+  using output_t = typename Worker::output_t;
+
+  if constexpr (util::emits_many_v<decltype(w._f)>) {
+    util::for_each_output(std::forward<Result>(res), [&](auto&& value) {
+      output_t output(std::forward<decltype(value)>(value));
+      if (!w._pending.empty() || !w._output_queue.push_unless(std::move(output), p))
+        w._pending.push_back(std::move(output));
+    });
+    return w._pending.empty();
+  } else {
+    if (w._output_queue.push_unless(std::move(res), p))
+      return true;
+    w._pending.push_back(std::move(res));
+    return false;
+  }
+}
+
+// The step of every worker with both input and output. 'call' invokes the stage with an element of the batch.
+template <typename Worker, typename Pred, typename Call>
+step_result process_batch(Worker& w, Pred& p, Call&& call) {
+  bool progressed = false;
+
+  if (!send_pending(w, p, progressed) || !flush_output(w._output_queue, p))
+    return {progressed, true};
+
+  if (w._batch.empty() && w._input_queue.drain_into(w._batch, p) == 0)
+    return {progressed, false};
+
+  while (!w._batch.empty() && !w._stop) {
+    auto res = call(w._batch.front());
+    w._batch.pop_front();
+    if (!send_outputs(w, std::move(res), p))
+      return {true, true};
+  }
+  return {true, !flush_output(w._output_queue, p)};
+}
+
+// tdp::batch stages collect their inputs into batches, instead of being called with each of them
+template <typename Stage>
+struct stage_batch;
+
+// The inputs collected for the next batch, and when it must be sent
+template <typename Callable, typename Output, bool = stage_batch<Callable>::value>
+struct batch_buffer {};
+
+template <typename Callable, typename Output>
+struct batch_buffer<Callable, Output, true> {
+  Output _inputs;
+  std::chrono::steady_clock::time_point _deadline;
+};
+
+// The step of a worker running a tdp::batch stage. 'take' moves the input out of an element of the batch.
+// The collected inputs are sent once there are as many as the batch size, or once the first one waited for max_delay.
+// A step that can't wait, as p() already holds, sends them as soon as the input runs out.
+template <typename Worker, typename Pred, typename Take>
+step_result collect_batch(Worker& w, Pred& p, Take&& take) {
+  using batch_t = stage_batch<decltype(w._f)>;
+  auto& buffer = w._collected;
+  bool progressed = false;
+
+  if (!send_pending(w, p, progressed) || !flush_output(w._output_queue, p))
+    return {progressed, true};
+
+  if (w._batch.empty()) {
+    const auto n = buffer._inputs.empty() ? w._input_queue.drain_into(w._batch, p)
+                                          : w._input_queue.drain_until(w._batch, p, buffer._deadline);
+    if (n == 0) {
+      if (buffer._inputs.empty() || (!p() && std::chrono::steady_clock::now() < buffer._deadline))
+        return {progressed, false};
+      return {true, !send_outputs(w, std::exchange(buffer._inputs, {}), p)};
+    }
+  }
+
+  while (!w._batch.empty() && !w._stop) {
+    if (buffer._inputs.empty()) {
+      buffer._inputs.reserve(batch_t::size);
+      buffer._deadline = std::chrono::steady_clock::now() + batch_t::max_delay(w._f);
+    }
+    buffer._inputs.push_back(take(w._batch.front()));
+    w._batch.pop_front();
+    if (buffer._inputs.size() == batch_t::size && !send_outputs(w, std::exchange(buffer._inputs, {}), p))
+      return {true, true};
+  }
+  return {true, !flush_output(w._output_queue, p)};
+}
+
+template <typename Input, typename Callable, typename InputQueue, typename OutputQueue, typename = void,
+    typename = void>
 struct thread_worker;
 
 // Normal input
-template <template <typename...> class Queue, typename... InputArgs, typename Callable>
-struct thread_worker<Queue, jtc::type_list<InputArgs...>, Callable,  //
-    std::enable_if_t<sizeof...(InputArgs) != 0>,                     //
+template <typename... InputArgs, typename Callable, typename InputQueue, typename OutputQueue>
+struct thread_worker<jtc::type_list<InputArgs...>, Callable, InputQueue, OutputQueue,  //
+    std::enable_if_t<sizeof...(InputArgs) != 0>,                                       //
     std::enable_if_t<!std::is_same_v<std::invoke_result_t<Callable, InputArgs...>, void>>> {
   using input_t = std::tuple<InputArgs...>;
-  using output_t = std::invoke_result_t<Callable, InputArgs...>;
+  using output_t = util::stage_output_t<Callable, InputArgs...>;
 
   Callable _f;
-  Queue<input_t>& _input_queue;
-  Queue<output_t>& _output_queue;
+  InputQueue _input_queue;
+  OutputQueue _output_queue;
   const std::atomic_bool& _stop;
+  std::deque<input_t> _batch = {};
+  std::deque<output_t> _pending = {};
+  batch_buffer<Callable, output_t> _collected = {};
 
   void operator()() noexcept {
-    while (!_stop) {
-      auto val = _input_queue.pop_unless([&] { return _stop.load(); });
-      if (!val)
-        break;
-      auto&& res = std::apply(_f, std::move(*val));
-      _output_queue.push(std::move(res));
-    }
+    auto stop = [&] { return _stop.load(); };
+    while (!_stop)
+      step(stop);
     _output_queue.wake();
   }
+
+  template <typename Pred>
+  step_result step(Pred&& p) noexcept {
+    if constexpr (stage_batch<Callable>::value)
+      return collect_batch(*this, p, [](input_t& args) { return std::get<0>(std::move(args)); });
+    else
+      return process_batch(*this, p, [&](input_t& args) { return std::apply(_f, std::move(args)); });
+  }
 };
 
 // Producer thread
-template <template <typename...> class Queue, typename Callable>
-struct thread_worker<Queue, jtc::type_list<>, Callable> {
-  using output_t = std::invoke_result_t<Callable>;
+template <typename Callable, typename OutputQueue>
+struct thread_worker<jtc::type_list<>, Callable, void, OutputQueue> {
+  using output_t = util::stage_output_t<Callable>;
 
   Callable _f;
-  Queue<output_t>& _output_queue;
+  OutputQueue _output_queue;
   const std::atomic_bool& _pause;
   const std::atomic_bool& _stop;
+  std::deque<output_t> _pending = {};
 
   void operator()() noexcept {
-    while (!_stop) {
-      if (!_pause)
-        _output_queue.push(std::invoke(_f));
-    }
+    auto stop = [&] { return _stop.load(); };
+    while (!_stop)
+      step(stop);
     _output_queue.wake();
   }
+
+  // Produces a single element
+  template <typename Pred>
+  step_result step(Pred&& p) noexcept {
+    bool progressed = false;
+
+    if (!send_pending(*this, p, progressed) || !flush_output(_output_queue, p))
+      return {progressed, true};
+
+    if (_pause)
+      return {progressed, false};
+
+    if (!send_outputs(*this, std::invoke(_f), p))
+      return {true, true};
+    return {true, !flush_output(_output_queue, p)};
+  }
 };
 
 // Consumer thread
-template <template <typename...> class Queue, typename Input, typename Callable>
-struct thread_worker<Queue, Input, Callable,                           //
+template <typename Input, typename Callable, typename InputQueue>
+struct thread_worker<Input, Callable, InputQueue, void,                //
     std::enable_if_t<!util::is_instance_of_v<Input, jtc::type_list>>,  //
     std::enable_if_t<std::is_same_v<std::invoke_result_t<Callable, Input>, void>>> {
   Callable _f;
-  Queue<Input>& _input_queue;
+  InputQueue _input_queue;
   const std::atomic_bool& _stop;
+  std::deque<Input> _batch = {};
 
   void operator()() noexcept {
-    while (!_stop) {
-      auto val = _input_queue.pop_unless([&] { return _stop.load(); });
-      if (!val)
-        break;
-      std::invoke(_f, std::move(*val));
-    }
+    auto stop = [&] { return _stop.load(); };
+    while (!_stop)
+      step(stop);
+  }
+
+  template <typename Pred>
+  step_result step(Pred&& p) noexcept {
+    if (_input_queue.drain_into(_batch, p) == 0)
+      return {false, false};
+
+    for (; !_batch.empty() && !_stop; _batch.pop_front())
+      std::invoke(_f, std::move(_batch.front()));
+    return {true, false};
   }
 };
 
 // Input+Consumer thread for a consumer-only pipeline
-template <template <typename...> class Queue, typename... InputArgs, typename Callable>
-struct thread_worker<Queue, jtc::type_list<InputArgs...>, Callable,  //
-    std::enable_if_t<sizeof...(InputArgs) != 0>,                     //
+template <typename... InputArgs, typename Callable, typename InputQueue>
+struct thread_worker<jtc::type_list<InputArgs...>, Callable, InputQueue, void,  //
+    std::enable_if_t<sizeof...(InputArgs) != 0>,                                //
     std::enable_if_t<std::is_same_v<std::invoke_result_t<Callable, InputArgs...>, void>>> {
   using input_t = std::tuple<InputArgs...>;
 
   Callable _f;
-  Queue<input_t>& _input_queue;
+  InputQueue _input_queue;
   const std::atomic_bool& _stop;
+  std::deque<input_t> _batch = {};
 
   void operator()() noexcept {
-    while (!_stop) {
-      auto val = _input_queue.pop_unless([&] { return _stop.load(); });
-      if (!val)
-        break;
-      std::apply(_f, std::move(*val));
-    }
+    auto stop = [&] { return _stop.load(); };
+    while (!_stop)
+      step(stop);
+  }
+
+  template <typename Pred>
+  step_result step(Pred&& p) noexcept {
+    if (_input_queue.drain_into(_batch, p) == 0)
+      return {false, false};
+
+    for (; !_batch.empty() && !_stop; _batch.pop_front())
+      std::apply(_f, std::move(_batch.front()));
+    return {true, false};
   }
 };
 
 // Normal output/middle thread
-template <template <typename...> class Queue, typename Input, typename Callable>
-struct thread_worker<Queue, Input, Callable,                           //
+template <typename Input, typename Callable, typename InputQueue, typename OutputQueue>
+struct thread_worker<Input, Callable, InputQueue, OutputQueue,         //
     std::enable_if_t<!util::is_instance_of_v<Input, jtc::type_list>>,  //
     std::enable_if_t<!std::is_same_v<std::invoke_result_t<Callable, Input>, void>>> {
-  using output_t = std::invoke_result_t<Callable, Input>;
+  using output_t = util::stage_output_t<Callable, Input>;
 
   Callable _f;
-  Queue<Input>& _input_queue;
-  Queue<output_t>& _output_queue;
+  InputQueue _input_queue;
+  OutputQueue _output_queue;
   const std::atomic_bool& _stop;
+  std::deque<Input> _batch = {};
+  std::deque<output_t> _pending = {};
+  batch_buffer<Callable, output_t> _collected = {};
 
   void operator()() noexcept {
-    while (!_stop) {
-      auto val = _input_queue.pop_unless([&] { return _stop.load(); });
-      if (!val)
+    auto stop = [&] { return _stop.load(); };
+    while (!_stop)
+      step(stop);
+    _output_queue.wake();
+  }
+
+  template <typename Pred>
+  step_result step(Pred&& p) noexcept {
+    if constexpr (stage_batch<Callable>::value)
+      return collect_batch(*this, p, [](Input& x) { return std::move(x); });
+    else
+      return process_batch(*this, p, [&](Input& x) { return std::invoke(_f, std::move(x)); });
+  }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Executors
+//
+// The thread executor runs each replica of a stage on its own thread, which waits inside the queues.
+//
+// The work-stealing executor runs each replica as a stage_task on a util::work_stealing_pool.
+// The pool is owned by the pipeline, or shared by the pipelines registered with the same scheduler.
+// A task is scheduled when an element is pushed to its input. It runs steps of its worker without waiting,
+// and goes idle once it's out of input.
+// A task left with an element it can't send is blocked. Blocked tasks are scheduled again whenever another task of
+// the pipeline makes progress, or the user takes an output. The output of a linked pipeline is taken by the other one.
+//-------------------------------------------------------------------------------------------------
+
+struct thread_executor {};
+
+struct work_stealing_executor {
+  std::size_t _threads;
+};
+
+struct shared_executor {
+  util::work_stealing_pool* _pool;
+};
+
+// Whether an executor runs the stages as tasks on a pool
+template <typename Executor>
+struct runs_tasks : std::false_type {};
+
+template <>
+struct runs_tasks<work_stealing_executor> : std::true_type {};
+
+template <>
+struct runs_tasks<shared_executor> : std::true_type {};
+
+template <typename Executor>
+inline constexpr bool runs_tasks_v = runs_tasks<Executor>::value;
+
+class stage_task;
+
+// The tasks of a pipeline, and the pool running them
+struct task_context {
+  util::work_stealing_pool& _pool;
+  const std::atomic_bool& _stop;
+  stage_task* const* _tasks;
+  std::size_t _count;
+
+  // Tasks that are scheduled or running, and tasks that are blocked
+  std::atomic<std::size_t> _active = 0;
+  std::atomic<std::size_t> _blocked = 0;
+
+  // The tasks of a pipeline linked to another one can block on its input. When the other pipeline runs tasks too,
+  // it counts them as well, and schedules them again as it makes progress.
+  task_context* _downstream = nullptr;
+  std::atomic<std::size_t> _upstream_blocked = 0;
+  std::mutex _upstream_mutex = {};
+  std::vector<task_context*> _upstream = {};
+
+  // Schedules every blocked task again
+  void unblock() noexcept;
+
+  void add_blocked() noexcept {
+    _blocked.fetch_add(1);
+    if (_downstream)
+      _downstream->_upstream_blocked.fetch_add(1);
+  }
+
+  void remove_blocked() noexcept {
+    _blocked.fetch_sub(1);
+    if (_downstream)
+      _downstream->_upstream_blocked.fetch_sub(1);
+  }
+
+  // Called before any task runs
+  void link(task_context& downstream) {
+    std::unique_lock lock{downstream._upstream_mutex};
+    downstream._upstream.push_back(this);
+    _downstream = &downstream;
+  }
+
+  // Called once no task runs
+  void unlink() noexcept {
+    if (!_downstream)
+      return;
+
+    std::unique_lock lock{_downstream->_upstream_mutex};
+    auto& upstream = _downstream->_upstream;
+    upstream.erase(std::find(upstream.begin(), upstream.end(), this));
+    _downstream->_upstream_blocked.fetch_sub(_blocked.load());
+    _downstream = nullptr;
+  }
+};
+
+class stage_task : public util::pool_task {
+ public:
+  // Steps run before going back to the end of the pool's queue
+  static constexpr std::size_t step_limit = 64;
+
+  explicit stage_task(task_context& context) noexcept : _context{context} {}
+  virtual ~stage_task() = default;
+
+  // Schedules the task, or makes it run again if it's running
+  void notify() noexcept {
+    auto& context = _context;
+
+    // Counted before checking the stop flag, so stopping the pipeline either sees this task or stops it
+    context._active.fetch_add(1);
+    if (!context._stop) {
+      auto state = _state.load();
+      while (true) {
+        if (state == idle && _state.compare_exchange_weak(state, queued)) {
+          context._pool.submit(*this);
+          return;
+        }
+        if (state == queued || state == rerun || (state == running && _state.compare_exchange_weak(state, rerun)))
+          break;
+      }
+    }
+    context._active.fetch_sub(1);
+  }
+
+  // Schedules the task if it's blocked
+  void unblock() noexcept {
+    if (_blocked.exchange(false)) {
+      _context.remove_blocked();
+      notify();
+    }
+  }
+
+ protected:
+  virtual step_result step() noexcept = 0;
+
+ private:
+  enum : int { idle, queued, running, rerun };
+
+  void run() noexcept final {
+    _state.store(running);
+    clear_blocked();
+
+    bool marked = false;
+    std::size_t steps = 0;
+    while (!_context._stop) {
+      if (steps++ == step_limit) {
+        // Let the other tasks run before continuing
+        _state.store(queued);
+        _context._pool.submit(*this);
+        return;
+      }
+
+      const auto r = step();
+      if (r.progressed) {
+        _context.unblock();
+        if (marked) {
+          clear_blocked();
+          marked = false;
+        }
+      }
+
+      if (!r.blocked && !r.progressed)
         break;
-      auto&& res = std::invoke(_f, std::move(*val));
-      _output_queue.push(std::move(res));
+
+      if (r.blocked && !r.progressed) {
+        if (marked)
+          break;
+
+        // The flag is published before stepping again, so a task making progress after that step schedules this one
+        _blocked.store(true);
+        _context.add_blocked();
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        marked = true;
+      }
     }
-    _output_queue.wake();
+
+    auto& context = _context;
+    int state = running;
+    if (context._stop || _state.compare_exchange_strong(state, idle)) {
+      _state.store(idle);
+      context._active.fetch_sub(1);
+      return;
+    }
+
+    // Notified while running
+    _state.store(queued);
+    context._pool.submit(*this);
+  }
+
+  void clear_blocked() noexcept {
+    if (_blocked.exchange(false))
+      _context.remove_blocked();
+  }
+
+  task_context& _context;
+  std::atomic<int> _state = idle;
+  std::atomic_bool _blocked = false;
+};
+
+inline void task_context::unblock() noexcept {
+  // Pairs with the fence of a task marking itself blocked
+  std::atomic_thread_fence(std::memory_order_seq_cst);
+  if (_upstream_blocked.load(std::memory_order_relaxed) != 0) {
+    std::unique_lock lock{_upstream_mutex};
+    for (auto* upstream : _upstream)
+      upstream->unblock();
+  }
+
+  if (_blocked.load(std::memory_order_relaxed) == 0)
+    return;
+
+  for (std::size_t i = 0; i < _count; i++)
+    _tasks[i]->unblock();
+}
+
+template <typename Worker>
+class worker_task final : public stage_task {
+ public:
+  worker_task(task_context& context, Worker&& worker) : stage_task{context}, _worker{std::move(worker)} {}
+
+ private:
+  step_result step() noexcept override {
+    return _worker.step([] { return true; });
+  }
+
+  Worker _worker;
+};
+
+// The tasks running the replicas of a stage
+struct task_group {
+  stage_task* const* _tasks = nullptr;
+  std::size_t _count = 0;
+
+  void notify() const noexcept {
+    for (std::size_t i = 0; i < _count; i++)
+      _tasks[i]->notify();
+  }
+};
+
+// A queue that schedules the tasks reading it when an element is pushed.
+// Taking elements from it is progress, so it also schedules the blocked tasks of the pipeline.
+template <typename T, typename Queue>
+class scheduled_queue : public Queue {
+ public:
+  void bind(task_group readers, task_context& context) noexcept {
+    _readers = readers;
+    _context = &context;
+  }
+
+  void push(T val) {
+    Queue::push(std::move(val));
+    _readers.notify();
+  }
+
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    Queue::push_range(std::move(first), std::move(last));
+    _readers.notify();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    return pushed(Queue::push_unless(std::move(val), std::forward<Pred>(p)));
+  }
+
+  bool try_push(T val) { return pushed(Queue::try_push(std::move(val))); }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>& timeout) {
+    return pushed(Queue::push_for(std::move(val), timeout));
+  }
+
+  T pop() {
+    auto r = Queue::pop();
+    popped(1);
+    return r;
   }
+
+  template <typename Pred>
+  std::optional<T> pop_unless(Pred&& p) {
+    auto r = Queue::pop_unless(std::forward<Pred>(p));
+    popped(r.has_value());
+    return r;
+  }
+
+  // Bounded queues give the space of drained elements back on the next drain, which is progress as well
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    return drained(Queue::drain_into(out, std::forward<Pred>(p)));
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    return drained(Queue::drain_until(out, std::forward<Pred>(p), deadline));
+  }
+
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    return popped(Queue::pop_n_unless(out, n, std::forward<Pred>(p)));
+  }
+
+ private:
+  bool pushed(bool r) {
+    if (r)
+      _readers.notify();
+    return r;
+  }
+
+  std::size_t popped(std::size_t n) {
+    if (n != 0 && _context)
+      _context->unblock();
+    return n;
+  }
+
+  std::size_t drained(std::size_t n) {
+    popped(std::exchange(_drained, n) + n);
+    return n;
+  }
+
+  task_group _readers;
+  task_context* _context = nullptr;
+  std::size_t _drained = 0;  // Only its reader drains a queue
+};
+
+// The queue type of an edge, for each executor
+template <typename Executor, bool Tasks = runs_tasks_v<Executor>>
+struct executor_queue {
+  template <typename T, typename Queue>
+  using queue_t = Queue;
+};
+
+template <typename Executor>
+struct executor_queue<Executor, true> {
+  template <typename T, typename Queue>
+  using queue_t = scheduled_queue<T, Queue>;
+};
+
+// Runs the workers of a pipeline, one per thread
+template <typename Executor, std::size_t Workers, bool Tasks = runs_tasks_v<Executor>>
+class execution {
+ public:
+  execution(thread_executor, const std::atomic_bool&) noexcept {}
+
+  template <typename Worker>
+  void start(std::size_t index, Worker&& worker) {
+    _threads[index] = std::thread(std::forward<Worker>(worker));
+  }
+
+  // Called once every worker was started
+  void run() noexcept {}
+
+  // Called once the stop flag is set, and every queue woken
+  void join() {
+    for (auto& thread : _threads)
+      if (thread.joinable())
+        thread.join();
+  }
+
+ private:
+  std::array<std::thread, Workers> _threads;
+};
+
+// Runs the workers of a pipeline as tasks on a pool, either its own or a scheduler's
+template <typename Executor, std::size_t Workers>
+class execution<Executor, Workers, true> {
+ public:
+  execution(work_stealing_executor executor, const std::atomic_bool& stop)
+      : _pool{std::make_unique<util::work_stealing_pool>(executor._threads)},
+        _context{*_pool, stop, _task_pointers.data(), Workers} {}
+
+  execution(shared_executor executor, const std::atomic_bool& stop)
+      : _context{*executor._pool, stop, _task_pointers.data(), Workers} {}
+
+  template <typename Worker>
+  void start(std::size_t index, Worker&& worker) {
+    _tasks[index] = std::make_unique<worker_task<std::decay_t<Worker>>>(_context, std::forward<Worker>(worker));
+    _task_pointers[index] = _tasks[index].get();
+  }
+
+  task_context& context() noexcept { return _context; }
+
+  task_group group(std::size_t first, std::size_t count) const noexcept { return {&_task_pointers[first], count}; }
+
+  // Every task runs once, so producers start producing
+  void run() noexcept {
+    for (auto* task : _task_pointers)
+      task->notify();
+  }
+
+  // Waits for every task to leave the pool. A shared pool keeps running the tasks of other pipelines.
+  void join() {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    while (_context._active.load() != 0)
+      std::this_thread::yield();
+    _pool.reset();
+  }
+
+ private:
+  std::array<std::unique_ptr<stage_task>, Workers> _tasks;
+  std::array<stage_task*, Workers> _task_pointers = {};
+  std::unique_ptr<util::work_stealing_pool> _pool;  // Null on a shared pool
+  task_context _context;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -151,10 +751,29 @@ struct pipeline_input<Queue, jtc::type_list<InputArgs...>> {
   using storage_t = std::tuple<InputArgs...>;
 
   void input(InputArgs... args) { _input_queue.push(storage_t(std::move(args)...)); }
+
+  template <typename InputIt>
+  void input_range(InputIt first, InputIt last) {
+    using element_t = typename std::iterator_traits<InputIt>::reference;
+    static_assert(std::is_constructible_v<storage_t, element_t>,
+        "The range elements must be convertible to the input arguments. Use tuples for multiple arguments.");
+    _input_queue.push_range(std::move(first), std::move(last));
+  }
+
+  void input_range(std::initializer_list<storage_t> values) { _input_queue.push_range(values.begin(), values.end()); }
+
+  [[nodiscard]] bool try_input(InputArgs... args) { return _input_queue.try_push(storage_t(std::move(args)...)); }
+
+  template <typename Rep, typename Period>
+  [[nodiscard]] bool input_for(const std::chrono::duration<Rep, Period>& timeout, InputArgs... args) {
+    return _input_queue.push_for(storage_t(std::move(args)...), timeout);
+  }
+
   [[nodiscard]] bool input_is_empty() const noexcept { return _input_queue.empty(); }
 
  protected:
-  Queue<storage_t> _input_queue;
+  using input_queue_t = Queue<storage_t>;
+  input_queue_t _input_queue;
 };
 
 // Producer
@@ -162,53 +781,1330 @@ template <template <typename...> class Queue>
 struct pipeline_input<Queue, jtc::type_list<>> {
   [[nodiscard]] bool producing() const noexcept { return !_paused; }
   void pause() noexcept { _paused = true; }
-  void resume() noexcept { _paused = false; }
+  void resume() noexcept {
+    _paused = false;
+    _producers.notify();
+  }
 
  protected:
   std::atomic_bool _paused = false;  // TODO: Have something like C++20's atomic_flag::wait
+  task_group _producers;             // Paused producer tasks go idle, so they're scheduled on resume
+};
+
+// Regular output
+template <template <typename...> class Queue, typename OutputType, bool Linked = false>
+struct pipeline_output {
+  [[nodiscard]] bool available() const noexcept { return !_output_queue.empty(); }
+  [[nodiscard]] bool empty() const noexcept { return _output_queue.empty(); }
+
+  [[nodiscard]] OutputType wait_get() noexcept { return _output_queue.pop(); }
+
+  [[nodiscard]] std::optional<OutputType> try_get() noexcept {
+    if (_output_queue.empty())
+      return std::nullopt;
+    return _output_queue.pop();
+  }
+
+  [[nodiscard]] std::vector<OutputType> wait_get_n(std::size_t n) {
+    std::vector<OutputType> r;
+    r.reserve(n);
+
+    auto out = std::back_inserter(r);
+    while (r.size() < n)
+      _output_queue.pop_n_unless(out, n - r.size(), [] { return false; });
+
+    return r;
+  }
+
+  template <typename OutputIt>
+  [[nodiscard]] std::size_t try_get_up_to(std::size_t n, OutputIt out) noexcept {
+    return _output_queue.pop_n_unless(out, n, [] { return true; });
+  }
+
+  template <typename OutputIt>
+  [[nodiscard]] OutputIt drain_to(OutputIt out) noexcept {
+    _output_queue.pop_n_unless(out, std::numeric_limits<std::size_t>::max(), [] { return true; });
+    return out;
+  }
+
+ protected:
+  using output_queue_t = Queue<OutputType>;
+  output_queue_t _output_queue;
+};
+
+// Consumer
+template <template <typename...> class Queue>
+struct pipeline_output<Queue, void> {};
+
+// Linked output, taken by the target pipeline
+template <template <typename...> class Queue, typename OutputType>
+struct pipeline_output<Queue, OutputType, true> {
+ protected:
+  using output_queue_t = Queue<OutputType>;
+  output_queue_t _output_queue;
+};
+
+//-------------------------------------------------------------------------------------------------
+// Stage wrappers
+//
+// A stage preceded by tdp::via() is stored as a via_stage, which marks the queue feeding it.
+// A stage created with tdp::parallel<N>() is stored as a parallel_stage, which is run by N threads.
+// A stage created with tdp::ordered_parallel<N>() is stored as an ordered_stage, which also keeps the input order.
+// A stage created with tdp::partition<N>() is stored as a partition_stage, whose threads each read their own queue.
+// All of them forward their calls to the wrapped callable.
+//
+// tdp::filter{pred} and tdp::filter_map{f} return a std::optional, and emit many: only engaged values are sent.
+// tdp::flat_map{f} returns a range, and emits many: each of its elements is sent.
+//
+// A stage created with tdp::batch<N>() is stored as a batch_stage. Its worker collects the inputs into a std::vector,
+// and only calls it directly when used as a plain callable. tdp::unbatch sends each element of a batch.
+//
+// tdp::fuse{f, g, ...} isn't a wrapper, but a single callable chaining its functions: ...g(f(args...)).
+//
+// tdp::fork{a, b, ...} is run by a replica per branch, each reading its own queue of shared pointers to the inputs.
+// Each replica calls its branch through a fork_branch, and the fork only calls them all when used as a plain callable.
+// tdp::route{selector, a, b, ...} is also run by a replica per branch, each reading the inputs its selector sends it.
+//
+// A stage followed by tdp::tap{observer} is stored as a tap_stage. Its replicas run the wrapped stage, offering copies
+// of their outputs to the observer, which runs on a worker of its own.
+//
+// The last stage of a pipeline ending in tdp::into(target) is stored as a link_stage, holding a share of the target.
+// Its replicas run the wrapped stage, pushing their outputs straight to the input of the target.
+//-------------------------------------------------------------------------------------------------
+
+template <template <typename...> class Queue, typename F>
+struct via_stage {
+  static constexpr bool emits_many = util::emits_many_v<F>;
+
+  F _f;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
 };
 
-// Regular output
-template <template <typename...> class Queue, typename OutputType>
-struct pipeline_output {
-  [[nodiscard]] bool available() const noexcept { return !_output_queue.empty(); }
-  [[nodiscard]] bool empty() const noexcept { return _output_queue.empty(); }
+template <std::size_t Size>
+struct batch_stage {
+  static_assert(Size > 0, "A batch must hold at least one input.");
+
+  std::chrono::steady_clock::duration _max_delay;
+
+  template <typename T>
+  constexpr std::vector<std::decay_t<T>> operator()(T&& x) const {
+    std::vector<std::decay_t<T>> batch;
+    batch.push_back(std::forward<T>(x));
+    return batch;
+  }
+};
+
+// The size and delay of the batches of a stage, if it's a batch_stage
+template <typename Stage>
+struct stage_batch : std::false_type {};
+
+template <std::size_t Size>
+struct stage_batch<batch_stage<Size>> : std::true_type {
+  static constexpr std::size_t size = Size;
+  static auto max_delay(const batch_stage<Size>& stage) noexcept { return stage._max_delay; }
+};
+
+template <template <typename...> class Queue, typename F>
+struct stage_batch<via_stage<Queue, F>> : stage_batch<F> {
+  static auto max_delay(const via_stage<Queue, F>& stage) noexcept { return stage_batch<F>::max_delay(stage._f); }
+};
+
+template <std::size_t Replicas, typename F>
+struct parallel_stage {
+  static_assert(Replicas > 0, "A parallel stage must run on at least one thread.");
+  static_assert(Replicas == 1 || std::is_copy_constructible_v<F>, "Each thread of a parallel stage needs a copy of it.");
+  static_assert(!stage_batch<F>::value, "Batches are collected by a single thread.");
+
+  static constexpr bool emits_many = util::emits_many_v<F>;
+
+  F _f;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+};
+
+template <std::size_t Replicas, std::size_t Window, typename F>
+struct ordered_stage {
+  static_assert(Replicas > 0, "A parallel stage must run on at least one thread.");
+  static_assert(Replicas == 1 || std::is_copy_constructible_v<F>, "Each thread of a parallel stage needs a copy of it.");
+  static_assert(Window >= Replicas, "The reorder window must fit an element from each thread.");
+  static_assert(!util::emits_many_v<F>, "Ordered stages must send a single output per input.");
+  static_assert(!stage_batch<F>::value, "Batches are collected by a single thread.");
+
+  F _f;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+};
+
+template <std::size_t Replicas, typename Key, typename F>
+struct partition_stage {
+  static_assert(Replicas > 0, "A parallel stage must run on at least one thread.");
+  static_assert(Replicas == 1 || std::is_copy_constructible_v<F>, "Each thread of a parallel stage needs a copy of it.");
+  static_assert(std::is_copy_constructible_v<Key>, "The key function is copied into the edge feeding the stage.");
+  static_assert(!stage_batch<F>::value, "Batches are collected by a single thread.");
+
+  static constexpr bool emits_many = util::emits_many_v<F>;
+
+  Key _key;
+  F _f;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+};
+
+template <std::size_t Replicas, typename F>
+[[nodiscard]] constexpr auto parallel(F&& f) noexcept(std::is_nothrow_constructible_v<std::decay_t<F>, F>) {
+  return parallel_stage<Replicas, std::decay_t<F>>{std::forward<F>(f)};
+}
+
+template <std::size_t Replicas, std::size_t Window = 2 * Replicas, typename F>
+[[nodiscard]] constexpr auto ordered_parallel(F&& f) noexcept(std::is_nothrow_constructible_v<std::decay_t<F>, F>) {
+  return ordered_stage<Replicas, Window, std::decay_t<F>>{std::forward<F>(f)};
+}
+
+template <std::size_t Size, typename Rep, typename Period>
+[[nodiscard]] constexpr auto batch(const std::chrono::duration<Rep, Period>& max_delay) noexcept {
+  return batch_stage<Size>{std::chrono::ceil<std::chrono::steady_clock::duration>(max_delay)};
+}
+
+template <std::size_t Replicas, typename Key, typename F>
+[[nodiscard]] constexpr auto partition(Key&& key, F&& f) noexcept(
+    std::is_nothrow_constructible_v<std::decay_t<Key>, Key> && std::is_nothrow_constructible_v<std::decay_t<F>, F>) {
+  return partition_stage<Replicas, std::decay_t<Key>, std::decay_t<F>>{std::forward<Key>(key), std::forward<F>(f)};
+}
+
+template <typename Pred>
+class filter {
+  static_assert(std::is_move_constructible_v<Pred>);
+
+ public:
+  static constexpr bool emits_many = true;
+
+  constexpr explicit filter(Pred pred) noexcept(std::is_nothrow_move_constructible_v<Pred>) : _pred{std::move(pred)} {}
+
+  template <typename T, typename = std::enable_if_t<std::is_invocable_r_v<bool, Pred&, const std::decay_t<T>&>>>
+  constexpr std::optional<std::decay_t<T>> operator()(T&& x) {
+    if (std::invoke(_pred, std::as_const(x)))
+      return std::forward<T>(x);
+    return std::nullopt;
+  }
+
+ private:
+  Pred _pred;
+};
+
+template <typename Pred>
+filter(Pred) -> filter<Pred>;
+
+template <typename F>
+class filter_map {
+  static_assert(std::is_move_constructible_v<F>);
+
+ public:
+  static constexpr bool emits_many = true;
+
+  constexpr explicit filter_map(F f) noexcept(std::is_nothrow_move_constructible_v<F>) : _f{std::move(f)} {}
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    static_assert(util::is_instance_of_v<std::invoke_result_t<F&, Args...>, std::optional>,
+        "A filter_map stage must return a std::optional.");
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+
+ private:
+  F _f;
+};
+
+template <typename F>
+filter_map(F) -> filter_map<F>;
+
+// Whether T can be iterated with a range-based for loop
+template <typename T, typename = void>
+struct is_range : std::false_type {};
+
+template <typename T>
+struct is_range<T, std::void_t<decltype(std::begin(std::declval<T&>()), std::end(std::declval<T&>()))>>
+    : std::true_type {};
+
+template <typename F>
+class flat_map {
+  static_assert(std::is_move_constructible_v<F>);
+
+ public:
+  static constexpr bool emits_many = true;
+
+  constexpr explicit flat_map(F f) noexcept(std::is_nothrow_move_constructible_v<F>) : _f{std::move(f)} {}
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    static_assert(is_range<std::invoke_result_t<F&, Args...>>::value, "A flat_map stage must return a range.");
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+
+ private:
+  F _f;
+};
+
+template <typename F>
+flat_map(F) -> flat_map<F>;
+
+struct unbatch_stage {
+  static constexpr bool emits_many = true;
+
+  template <typename Batch, typename = std::enable_if_t<is_range<std::decay_t<Batch>>::value>>
+  constexpr std::decay_t<Batch> operator()(Batch&& batch) const {
+    return std::forward<Batch>(batch);
+  }
+};
+
+// The result of calling each of Fs with the result of the previous one, first with Args. Absent if any call is invalid.
+template <typename Fs, typename Args, typename = void>
+struct fused_result {};
+
+template <typename F, typename... Args>
+struct fused_result<jtc::type_list<F>, jtc::type_list<Args...>, std::void_t<std::invoke_result_t<F&, Args...>>> {
+  using type = std::invoke_result_t<F&, Args...>;
+};
+
+template <typename F, typename G, typename... Fs, typename... Args>
+struct fused_result<jtc::type_list<F, G, Fs...>, jtc::type_list<Args...>,
+    std::void_t<std::invoke_result_t<F&, Args...>>>
+    : fused_result<jtc::type_list<G, Fs...>, jtc::type_list<std::invoke_result_t<F&, Args...>>> {};
+
+template <typename... F>
+class fuse {
+  static_assert(sizeof...(F) > 0, "A fused stage needs at least one function.");
+  static_assert((std::is_move_constructible_v<F> && ...));
+  static_assert(!(stage_batch<F>::value || ...), "Batch stages can't be fused.");
+
+ public:
+  static constexpr bool emits_many = util::emits_many_v<jtc::list_get_t<jtc::type_list<F...>, sizeof...(F) - 1>>;
+  static_assert((int{util::emits_many_v<F>} + ...) == int{emits_many},
+      "Only the last function of a fused stage can send many outputs.");
+
+  constexpr explicit fuse(F... f) noexcept(util::are_nothrow_move_constructible_v<F...>) : _f{std::move(f)...} {}
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) ->
+      typename fused_result<jtc::type_list<F...>, jtc::type_list<Args&&...>>::type {
+    return call<0>(std::forward<Args>(args)...);
+  }
+
+ private:
+  template <std::size_t I, typename... Args>
+  constexpr decltype(auto) call(Args&&... args) {
+    if constexpr (I + 1 == sizeof...(F))
+      return std::invoke(std::get<I>(_f), std::forward<Args>(args)...);
+    else
+      return call<I + 1>(std::invoke(std::get<I>(_f), std::forward<Args>(args)...));
+  }
+
+  std::tuple<F...> _f;
+};
+
+template <typename... F>
+fuse(F...) -> fuse<F...>;
+
+// The results of a fork's branches, or void if they're all consumers. Absent if any branch can't take Args.
+template <typename Branches, typename Args, typename = void>
+struct fork_result {};
+
+template <typename... Branches, typename... Args>
+struct fork_result<jtc::type_list<Branches...>, jtc::type_list<Args...>,
+    std::void_t<std::invoke_result_t<Branches&, const std::decay_t<Args>&...>...>> {
+  static constexpr bool consumes =
+      (std::is_void_v<std::invoke_result_t<Branches&, const std::decay_t<Args>&...>> && ...);
+  static_assert(consumes || (!std::is_void_v<std::invoke_result_t<Branches&, const std::decay_t<Args>&...>> && ...),
+      "Either all branches of a fork return a value, or none of them does.");
+
+  using type = std::conditional_t<consumes, void,
+      std::tuple<std::decay_t<std::invoke_result_t<Branches&, const std::decay_t<Args>&...>>...>>;
+};
+
+// Calls a branch with the input shared by all branches. With Spread, the input is a tuple of arguments.
+template <std::size_t B, typename F, bool Spread>
+struct fork_branch {
+  F _f;
+
+  template <typename T>
+  constexpr auto operator()(const std::shared_ptr<const T>& input) {
+    if constexpr (Spread)
+      return std::apply(_f, *input);
+    else
+      return std::invoke(_f, *input);
+  }
+};
+
+template <typename... Branches>
+class fork {
+  static_assert(sizeof...(Branches) > 1, "A fork needs at least two branches.");
+  static_assert((std::is_move_constructible_v<Branches> && ...));
+  static_assert(!(util::emits_many_v<Branches> || ...), "The branches of a fork must send a single output per input.");
+  static_assert(!(stage_batch<Branches>::value || ...), "The branches of a fork can't be batch stages.");
+
+ public:
+  constexpr explicit fork(Branches... branches) noexcept(util::are_nothrow_move_constructible_v<Branches...>)
+      : _branches{std::move(branches)...} {}
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) ->
+      typename fork_result<jtc::type_list<Branches...>, jtc::type_list<Args...>>::type {
+    return call(std::index_sequence_for<Branches...>{}, std::as_const(args)...);
+  }
+
+  // Branch B, as called by its replica
+  template <std::size_t B, bool Spread>
+  constexpr auto branch() && {
+    using branch_t = std::tuple_element_t<B, std::tuple<Branches...>>;
+    return fork_branch<B, branch_t, Spread>{std::move(std::get<B>(_branches))};
+  }
+
+ private:
+  template <std::size_t... Bs, typename... Args>
+  constexpr auto call(std::index_sequence<Bs...>, const Args&... args) {
+    using result_t = typename fork_result<jtc::type_list<Branches...>, jtc::type_list<Args...>>::type;
+    if constexpr (std::is_void_v<result_t>)
+      (std::invoke(std::get<Bs>(_branches), args...), ...);
+    else
+      return result_t{std::invoke(std::get<Bs>(_branches), args...)...};
+  }
+
+  std::tuple<Branches...> _branches;
+};
+
+template <typename... Branches>
+fork(Branches...) -> fork<Branches...>;
+
+// Runs each of its producers on its own thread, all of them writing to the same edge.
+// Called directly, it calls its producers in turn.
+template <typename... F>
+class merged_producers {
+  static_assert(sizeof...(F) > 0, "A merge needs at least one producer.");
+  static_assert((std::is_move_constructible_v<F> && ...));
+
+  using result_t = std::invoke_result_t<jtc::list_get_t<jtc::type_list<F...>, 0>&>;
+  static_assert((std::is_same_v<std::invoke_result_t<F&>, result_t> && ...),  //
+      "All producers must return the same type.");
+
+ public:
+  static constexpr bool emits_many = util::emits_many_v<jtc::list_get_t<jtc::type_list<F...>, 0>>;
+  static_assert(((util::emits_many_v<F> == emits_many) && ...),
+      "Either all producers send many outputs per call, or none of them does.");
+
+  constexpr explicit merged_producers(F... f) noexcept(util::are_nothrow_move_constructible_v<F...>)
+      : _f{std::move(f)...} {}
+
+  constexpr result_t operator()() { return call(std::index_sequence_for<F...>{}); }
+
+  // Producer B, as called by its replica
+  template <std::size_t B, bool>
+  constexpr auto branch() && {
+    return std::move(std::get<B>(_f));
+  }
+
+ private:
+  template <std::size_t... Is>
+  result_t call(std::index_sequence<Is...>) {
+    using call_t = result_t (*)(std::tuple<F...>&);
+    static constexpr call_t calls[] = {[](std::tuple<F...>& f) -> result_t { return std::invoke(std::get<Is>(f)); }...};
+    return calls[std::exchange(_next, (_next + 1) % sizeof...(F))](_f);
+  }
+
+  std::tuple<F...> _f;
+  std::size_t _next = 0;
+};
+
+// The result of the branches of a route, which must all be the same. Absent if any branch can't take Args.
+template <typename Branches, typename Args, typename = void>
+struct route_result {};
+
+template <typename Branch, typename... Branches, typename... Args>
+struct route_result<jtc::type_list<Branch, Branches...>, jtc::type_list<Args...>,
+    std::void_t<std::invoke_result_t<Branch&, Args...>, std::invoke_result_t<Branches&, Args...>...>> {
+  using type = std::invoke_result_t<Branch&, Args...>;
+  static_assert((std::is_same_v<std::invoke_result_t<Branches&, Args...>, type> && ...),
+      "All branches of a route must return the same type.");
+};
+
+// Sends each input to the branch its selector picks, by index.
+// Indexes past the last branch pick the last one, and so do negative ones.
+// Each branch runs on its own thread, reading its own queue, and all of them send their results to the same edge.
+// Called directly, it calls the picked branch.
+template <typename Selector, typename... Branches>
+class route {
+  static_assert(sizeof...(Branches) > 1, "A route needs at least two branches.");
+  static_assert(std::is_copy_constructible_v<Selector>, "The selector is copied into the edge feeding the route.");
+  static_assert((std::is_move_constructible_v<Branches> && ...));
+  static_assert(!(stage_batch<Branches>::value || ...), "The branches of a route can't be batch stages.");
+
+ public:
+  static constexpr bool emits_many = util::emits_many_v<jtc::list_get_t<jtc::type_list<Branches...>, 0>>;
+  static_assert(((util::emits_many_v<Branches> == emits_many) && ...),
+      "Either all branches of a route send many outputs per input, or none of them does.");
+
+  constexpr explicit route(Selector selector, Branches... branches) noexcept(
+      util::are_nothrow_move_constructible_v<Selector, Branches...>)
+      : _selector{std::move(selector)}, _branches{std::move(branches)...} {}
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) ->
+      typename route_result<jtc::type_list<Branches...>, jtc::type_list<Args...>>::type {
+    const auto index = static_cast<std::size_t>(std::invoke(_selector, std::as_const(args)...));
+    const auto b = std::min(index, sizeof...(Branches) - 1);
+    return call(b, std::index_sequence_for<Branches...>{}, std::forward<Args>(args)...);
+  }
+
+  const Selector& selector() const noexcept { return _selector; }
+
+  // Branch B, as called by its replica
+  template <std::size_t B, bool>
+  constexpr auto branch() && {
+    return std::move(std::get<B>(_branches));
+  }
+
+ private:
+  template <std::size_t... Bs, typename... Args>
+  auto call(std::size_t b, std::index_sequence<Bs...>, Args&&... args) {
+    using result_t = typename route_result<jtc::type_list<Branches...>, jtc::type_list<Args...>>::type;
+    using call_t = result_t (*)(std::tuple<Branches...>&, Args&&...);
+    static constexpr call_t calls[] = {[](std::tuple<Branches...>& branches, Args&&... a) -> result_t {
+      return std::invoke(std::get<Bs>(branches), std::forward<Args>(a)...);
+    }...};
+    return calls[b](_branches, std::forward<Args>(args)...);
+  }
+
+  Selector _selector;
+  std::tuple<Branches...> _branches;
+};
+
+template <typename Selector, typename... Branches>
+route(Selector, Branches...) -> route<Selector, Branches...>;
+
+// The branches run by the replicas of a stage, if any: each replica of a fork, a route or merged producers runs its own
+template <typename Stage>
+struct stage_branches : std::false_type {};
+
+template <typename Selector, typename... Branches>
+struct stage_branches<route<Selector, Branches...>> : std::true_type {
+  static route<Selector, Branches...>&& get(route<Selector, Branches...>& stage) noexcept { return std::move(stage); }
+};
+
+template <typename... Branches>
+struct stage_branches<fork<Branches...>> : std::true_type {
+  static fork<Branches...>&& get(fork<Branches...>& stage) noexcept { return std::move(stage); }
+};
+
+template <typename... F>
+struct stage_branches<merged_producers<F...>> : std::true_type {
+  static merged_producers<F...>&& get(merged_producers<F...>& stage) noexcept { return std::move(stage); }
+};
+
+template <template <typename...> class Queue, typename F>
+struct stage_branches<via_stage<Queue, F>> : stage_branches<F> {
+  static decltype(auto) get(via_stage<Queue, F>& stage) noexcept { return stage_branches<F>::get(stage._f); }
+};
+
+// Marks the outputs of the previous stage to be observed: stage >> tdp::tap{observer, every} >> next
+template <typename Observer>
+struct tap {
+  static_assert(std::is_move_constructible_v<Observer>);
+
+  Observer _observer;
+  std::size_t _every;
+
+  constexpr explicit tap(Observer observer, std::size_t every = 1) noexcept(
+      std::is_nothrow_move_constructible_v<Observer>)
+      : _observer{std::move(observer)}, _every{std::max<std::size_t>(every, 1)} {}
+};
+
+template <typename Observer>
+tap(Observer, std::size_t = 1) -> tap<Observer>;
+
+// Every _every-th output of the stage is offered to the observer
+template <typename Observer, typename F>
+struct tap_stage {
+  static_assert(!util::is_instance_of_v<F, tap_stage>, "A stage can only have one tap.");
+
+  static constexpr bool emits_many = util::emits_many_v<F>;
+
+  F _f;
+  Observer _observer;
+  std::size_t _every;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+};
+
+// Whether the outputs of a stage are observed by a tap
+template <typename Stage>
+struct stage_tap : std::false_type {};
+
+template <typename Observer, typename F>
+struct stage_tap<tap_stage<Observer, F>> : std::true_type {};
+
+template <typename Target, typename F>
+struct link_stage {
+  static constexpr bool emits_many = util::emits_many_v<F>;
+
+  F _f;
+  std::shared_ptr<Target> _target;
+
+  template <typename... Args>
+  constexpr auto operator()(Args&&... args) -> std::invoke_result_t<F&, Args...> {
+    return std::invoke(_f, std::forward<Args>(args)...);
+  }
+};
+
+// Whether a stage sends its outputs to the input of another pipeline
+template <typename Stage>
+struct stage_link : std::false_type {};
+
+template <typename Target, typename F>
+struct stage_link<link_stage<Target, F>> : std::true_type {};
+
+template <typename Target, typename F>
+struct stage_tap<link_stage<Target, F>> : stage_tap<F> {};
+
+// The number of threads running a stage
+template <typename Stage>
+struct stage_replicas : std::integral_constant<std::size_t, 1> {};
+
+template <std::size_t Replicas, typename F>
+struct stage_replicas<parallel_stage<Replicas, F>> : std::integral_constant<std::size_t, Replicas> {};
+
+template <std::size_t Replicas, std::size_t Window, typename F>
+struct stage_replicas<ordered_stage<Replicas, Window, F>> : std::integral_constant<std::size_t, Replicas> {};
+
+template <std::size_t Replicas, typename Key, typename F>
+struct stage_replicas<partition_stage<Replicas, Key, F>> : std::integral_constant<std::size_t, Replicas> {};
+
+template <typename... Branches>
+struct stage_replicas<fork<Branches...>> : std::integral_constant<std::size_t, sizeof...(Branches)> {};
+
+template <typename... F>
+struct stage_replicas<merged_producers<F...>> : std::integral_constant<std::size_t, sizeof...(F)> {};
+
+template <typename Selector, typename... Branches>
+struct stage_replicas<route<Selector, Branches...>> : std::integral_constant<std::size_t, sizeof...(Branches)> {};
+
+template <template <typename...> class Queue, typename F>
+struct stage_replicas<via_stage<Queue, F>> : stage_replicas<F> {};
+
+template <typename Observer, typename F>
+struct stage_replicas<tap_stage<Observer, F>> : stage_replicas<F> {};
+
+template <typename Target, typename F>
+struct stage_replicas<link_stage<Target, F>> : stage_replicas<F> {};
+
+template <typename Stage>
+inline constexpr std::size_t stage_replicas_v = stage_replicas<Stage>::value;
+
+// Whether the replicas of a stage may read from, or write to, its edges at the same time
+template <typename Stage>
+struct shares_input : std::bool_constant<(stage_replicas_v<Stage> > 1)> {};
+
+template <typename Stage>
+struct shares_output : std::bool_constant<(stage_replicas_v<Stage> > 1)> {};
+
+// Ordered stages access their edges one replica at a time, to assign and restore the order
+template <std::size_t Replicas, std::size_t Window, typename F>
+struct shares_input<ordered_stage<Replicas, Window, F>> : std::false_type {};
+
+template <std::size_t Replicas, std::size_t Window, typename F>
+struct shares_output<ordered_stage<Replicas, Window, F>> : std::false_type {};
+
+// Each replica of a partitioned stage reads its own queue
+template <std::size_t Replicas, typename Key, typename F>
+struct shares_input<partition_stage<Replicas, Key, F>> : std::false_type {};
+
+// Each branch of a fork reads its own queue, and their results are joined before being sent
+template <typename... Branches>
+struct shares_input<fork<Branches...>> : std::false_type {};
+
+template <typename... Branches>
+struct shares_output<fork<Branches...>> : std::false_type {};
+
+// Each branch of a route reads its own queue, and all of them write to the next edge
+template <typename Selector, typename... Branches>
+struct shares_input<route<Selector, Branches...>> : std::false_type {};
+
+template <template <typename...> class Queue, typename F>
+struct shares_input<via_stage<Queue, F>> : shares_input<F> {};
+
+template <template <typename...> class Queue, typename F>
+struct shares_output<via_stage<Queue, F>> : shares_output<F> {};
+
+template <typename Observer, typename F>
+struct shares_input<tap_stage<Observer, F>> : shares_input<F> {};
+
+template <typename Observer, typename F>
+struct shares_output<tap_stage<Observer, F>> : shares_output<F> {};
+
+template <typename Target, typename F>
+struct shares_input<link_stage<Target, F>> : shares_input<F> {};
+
+template <typename Target, typename F>
+struct shares_output<link_stage<Target, F>> : shares_output<F> {};
+
+// The queue type of a stage's input, built from the queue Q<U> of each element type U.
+// Unpartitioned stages read a single queue. Replicas of partitioned stages and branches of forks read their own,
+// through queue.partition(replica). Keyed stages give the queue their key function.
+template <typename Stage>
+struct stage_partitions {
+  static constexpr bool partitioned = false;
+  static constexpr bool keyed = false;
+  static constexpr bool lossless = false;
+
+  template <typename T, template <typename> class Q, bool Spread>
+  using queue_t = Q<T>;
+};
+
+template <std::size_t Replicas, typename Key, typename F>
+struct stage_partitions<partition_stage<Replicas, Key, F>> {
+  static constexpr bool partitioned = true;
+  static constexpr bool keyed = true;
+  static constexpr bool lossless = false;
+
+  template <typename T, template <typename> class Q, bool Spread>
+  using queue_t = util::partitioned_queue<T, Q<T>, Replicas, Key, Spread>;
+
+  static const Key& key(const partition_stage<Replicas, Key, F>& stage) noexcept { return stage._key; }
+};
+
+// The results of the branches are joined by position, so no branch can skip an input
+template <typename... Branches>
+struct stage_partitions<fork<Branches...>> {
+  static constexpr bool partitioned = true;
+  static constexpr bool keyed = false;
+  static constexpr bool lossless = true;
+
+  template <typename T, template <typename> class Q, bool Spread>
+  using queue_t = util::broadcast_queue<T, Q<std::shared_ptr<const T>>, sizeof...(Branches)>;
+};
+
+// The selector of a route gives the index of the queue itself, instead of a key to hash
+template <typename Selector, typename... Branches>
+struct stage_partitions<route<Selector, Branches...>> {
+  static constexpr bool partitioned = true;
+  static constexpr bool keyed = true;
+  static constexpr bool lossless = false;
+
+  template <typename T, template <typename> class Q, bool Spread>
+  using queue_t = util::partitioned_queue<T, Q<T>, sizeof...(Branches), Selector, Spread, false>;
+
+  static const Selector& key(const route<Selector, Branches...>& stage) noexcept { return stage.selector(); }
+};
+
+template <template <typename...> class Queue, typename F>
+struct stage_partitions<via_stage<Queue, F>> : stage_partitions<F> {
+  static const auto& key(const via_stage<Queue, F>& stage) noexcept { return stage_partitions<F>::key(stage._f); }
+};
+
+template <typename Observer, typename F>
+struct stage_partitions<tap_stage<Observer, F>> : stage_partitions<F> {
+  static const auto& key(const tap_stage<Observer, F>& stage) noexcept { return stage_partitions<F>::key(stage._f); }
+};
+
+template <typename Target, typename F>
+struct stage_partitions<link_stage<Target, F>> : stage_partitions<F> {
+  static const auto& key(const link_stage<Target, F>& stage) noexcept { return stage_partitions<F>::key(stage._f); }
+};
+
+//-------------------------------------------------------------------------------------------------
+// Stage state
+//
+// Data shared by the replicas of a stage, owned by the pipeline.
+//-------------------------------------------------------------------------------------------------
+
+struct stateless {};
+
+// Sequence numbers and reorder buffer of an ordered stage.
+// Inputs are numbered as replicas take them, and outputs wait in the buffer until all previous ones are sent.
+// A replica that gets Window elements ahead of the oldest unfinished one waits.
+template <typename T, std::size_t Replicas, std::size_t Window, typename Wait = util::hybrid_park>
+class ordering {
+  static_assert(!std::is_same_v<T, void>, "An ordered stage must return a value. Use tdp::parallel for consumers.");
+
+ public:
+  // Takes an element from 'queue', numbering it for 'replica'
+  template <typename Queue, typename U, typename Pred>
+  std::size_t take(Queue& queue, std::size_t replica, std::deque<U>& out, Pred&& p) {
+    std::unique_lock lock{_input_mutex};
+
+    auto it = std::back_inserter(out);
+    const auto n = queue.pop_n_unless(it, 1, std::forward<Pred>(p));
+    if (n != 0)
+      _sequence[replica] = _next_input++;
+    return n;
+  }
+
+  // Buffers the output of 'replica', then sends every buffered output that's next in order to 'queue'.
+  // Returns false, leaving val untouched, if the buffer has no room for it before p() holds.
+  template <typename Queue, typename Pred>
+  bool send(Queue& queue, std::size_t replica, T&& val, Pred&& p) {
+    const auto seq = _sequence[replica];
+    {
+      std::unique_lock lock{_output_mutex};
+      _window.wait(lock, [&] { return p() || seq - _next_output < Window; });
+      if (seq - _next_output >= Window)
+        return false;
+
+      _pending[seq % Window].emplace(std::move(val));
+      send_buffered(queue, p);
+    }
+    _window.notify_all();
+    return true;
+  }
+
+  // Sends the buffered outputs left behind by a full queue. Returns whether there's none left.
+  template <typename Queue, typename Pred>
+  bool flush(Queue& queue, Pred&& p) {
+    if (!_stalled.load(std::memory_order_relaxed))
+      return true;
+
+    bool flushed;
+    {
+      std::unique_lock lock{_output_mutex};
+      flushed = send_buffered(queue, p);
+    }
+    _window.notify_all();
+    return flushed;
+  }
+
+  void wake() {
+    { std::unique_lock lock{_output_mutex}; }
+    _window.notify_all();
+  }
+
+ private:
+  template <typename Queue, typename Pred>
+  bool send_buffered(Queue& queue, Pred& p) {
+    for (auto* next = &_pending[_next_output % Window]; next->has_value(); next = &_pending[_next_output % Window]) {
+      if (!queue.push_unless(std::move(**next), p)) {
+        _stalled.store(true, std::memory_order_relaxed);
+        return false;
+      }
+      next->reset();
+      _next_output++;
+    }
+    _stalled.store(false, std::memory_order_relaxed);
+    return true;
+  }
+
+  std::mutex _input_mutex;
+  std::size_t _next_input = 0;
+  std::array<std::size_t, Replicas> _sequence = {};
+
+  std::mutex _output_mutex;
+  std::size_t _next_output = 0;
+  std::array<std::optional<T>, Window> _pending;
+  std::atomic_bool _stalled = false;
+  Wait _window;
+};
+
+// Results of a fork's branches, waiting for the other branches to finish the same element.
+// Every branch gets the inputs in the same order, so the n-th result of each branch belongs to the n-th input.
+// A branch can get ahead of the others by as many elements as its input queue holds.
+template <typename T>
+class joining;
+
+template <typename... R>
+class joining<std::tuple<R...>> {
+ public:
+  // Buffers the result of branch B, then sends every complete tuple to 'queue'.
+  // Returns false, leaving val untouched, if a complete tuple is still waiting for space in the queue.
+  template <std::size_t B, typename Queue, typename Pred>
+  bool send(Queue& queue, std::tuple_element_t<B, std::tuple<R...>>&& val, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    if (!send_complete(queue, p))
+      return false;
+
+    std::get<B>(_results).push_back(std::move(val));
+    send_complete(queue, p);
+    return true;
+  }
+
+  // Sends the complete tuples left behind by a full queue. Returns whether there's none left.
+  template <typename Queue, typename Pred>
+  bool flush(Queue& queue, Pred&& p) {
+    if (!_stalled.load(std::memory_order_relaxed))
+      return true;
+
+    std::unique_lock lock{_mutex};
+    return send_complete(queue, p);
+  }
+
+ private:
+  template <typename Queue, typename Pred>
+  bool send_complete(Queue& queue, Pred& p) {
+    while (true) {
+      if (!_ready) {
+        if (!std::apply([](auto&... results) { return (!results.empty() && ...); }, _results)) {
+          _stalled.store(false, std::memory_order_relaxed);
+          return true;
+        }
+
+        std::apply([&](auto&... results) { _ready.emplace(std::move(results.front())...); }, _results);
+        std::apply([](auto&... results) { (results.pop_front(), ...); }, _results);
+      }
+
+      if (!queue.push_unless(std::move(*_ready), p)) {
+        _stalled.store(true, std::memory_order_relaxed);
+        return false;
+      }
+      _ready.reset();
+    }
+  }
+
+  std::mutex _mutex;
+  std::tuple<std::deque<R>...> _results;
+  std::optional<std::tuple<R...>> _ready;
+  std::atomic_bool _stalled = false;
+};
+
+template <typename Stage, typename Output>
+struct stage_state : jtc::make_type<stateless> {};
+
+template <typename... Branches, typename... R>
+struct stage_state<fork<Branches...>, std::tuple<R...>> : jtc::make_type<joining<std::tuple<R...>>> {};
+
+template <std::size_t Replicas, std::size_t Window, typename F, typename Output>
+struct stage_state<ordered_stage<Replicas, Window, F>, Output> : jtc::make_type<ordering<Output, Replicas, Window>> {};
+
+template <template <typename...> class Queue, typename F, typename Output>
+struct stage_state<via_stage<Queue, F>, Output> : stage_state<F, Output> {};
+
+template <typename Observer, typename F, typename Output>
+struct stage_state<tap_stage<Observer, F>, Output> : stage_state<F, Output> {};
+
+template <typename Target, typename F, typename Output>
+struct stage_state<link_stage<Target, F>, Output> : stage_state<F, Output> {};
+
+//-------------------------------------------------------------------------------------------------
+// Edges
+//
+// Every edge uses the pipeline's policy, unless the stage it feeds was preceded by tdp::via().
+// Edges next to a parallel stage are shared by many threads, so they use the concurrent form of their queue.
+// Edges feeding a partitioned stage hold one queue per replica.
+//-------------------------------------------------------------------------------------------------
+
+template <template <typename...> class Queue, typename Receiver>
+struct receiver_policy {
+  template <typename T>
+  using queue_t = Queue<T>;
+};
+
+template <template <typename...> class Queue, template <typename...> class Via, typename F>
+struct receiver_policy<Queue, via_stage<Via, F>> {
+  template <typename T>
+  using queue_t = Via<T>;
+};
+
+template <template <typename...> class Queue, typename Observer, typename F>
+struct receiver_policy<Queue, tap_stage<Observer, F>> : receiver_policy<Queue, F> {};
+
+template <template <typename...> class Queue, typename Target, typename F>
+struct receiver_policy<Queue, link_stage<Target, F>> : receiver_policy<Queue, F> {};
+
+// Triple buffers keep only the latest element. Receivers that need every input get a queue with the same wait.
+template <typename Queue>
+struct lossless_queue {
+  using type = Queue;
+};
+
+template <typename T, typename Wait>
+struct lossless_queue<util::blocking_triple_buffer<T, Wait>> {
+  using type = util::blocking_queue<T, Wait>;
+};
+
+template <typename T, typename Wait>
+struct lossless_queue<util::lock_free_triple_buffer<T, Wait>> {
+  using type = util::lock_free_segmented_queue<T, Wait>;
+};
+
+// Whether many threads can push to an edge of type Queue at the same time
+template <typename Queue>
+struct accepts_many_producers : std::is_same<typename Queue::concurrent_t, Queue> {};
+
+template <typename T, typename Queue>
+struct accepts_many_producers<scheduled_queue<T, Queue>> : accepts_many_producers<Queue> {};
+
+template <typename T, typename Queue, std::size_t Partitions, typename Key, bool Spread, bool Hash>
+struct accepts_many_producers<util::partitioned_queue<T, Queue, Partitions, Key, Spread, Hash>>
+    : accepts_many_producers<Queue> {};
+
+// Pushes to a broadcast queue are serialized
+template <typename T, typename Queue, std::size_t Branches>
+struct accepts_many_producers<util::broadcast_queue<T, Queue, Branches>> : std::true_type {};
+
+// The Sender of the user input and the Receiver of the user output are void
+template <template <typename...> class Queue, typename Sender, typename Receiver, typename Executor>
+struct edge_policy {
+  static constexpr bool shared = shares_output<Sender>::value || shares_input<Receiver>::value;
+
+  template <typename T>
+  using exclusive_t = typename receiver_policy<Queue, Receiver>::template queue_t<T>;
+
+  template <typename T>
+  using concurrent_t = std::conditional_t<shared, typename exclusive_t<T>::concurrent_t, exclusive_t<T>>;
+
+  template <typename T>
+  using kept_t = std::conditional_t<stage_partitions<Receiver>::lossless,
+                                    typename lossless_queue<concurrent_t<T>>::type, concurrent_t<T>>;
+
+  template <typename T>
+  using single_t = typename executor_queue<Executor>::template queue_t<T, kept_t<T>>;
+
+  // Only the user input is a tuple of arguments
+  template <typename T>
+  using queue_t = typename stage_partitions<Receiver>::template queue_t<T, single_t, std::is_void_v<Sender>>;
+};
+
+template <typename Target, typename T>
+class linked_output;
+
+// The output of a linked pipeline is the input of its target
+template <template <typename...> class Queue, typename Target, typename F, typename Executor>
+struct edge_policy<Queue, link_stage<Target, F>, void, Executor> {
+  template <typename T>
+  using queue_t = linked_output<Target, T>;
+};
+
+// Hands the replicas of a parallel stage one element at a time, spreading the work among them
+template <typename Queue>
+struct replica_input {
+  Queue& _queue;
+
+  template <typename T, typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    auto it = std::back_inserter(out);
+    return _queue.pop_n_unless(it, 1, std::forward<Pred>(p));
+  }
+};
+
+// The replicas of an ordered stage read and write through its ordering
+template <typename Queue, typename Ordering>
+struct ordered_input {
+  Queue& _queue;
+  Ordering& _ordering;
+  std::size_t _replica;
+
+  template <typename T, typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    return _ordering.take(_queue, _replica, out, std::forward<Pred>(p));
+  }
+};
+
+template <typename Queue, typename Ordering>
+struct ordered_output {
+  Queue& _queue;
+  Ordering& _ordering;
+  std::size_t _replica;
+
+  template <typename T, typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    return _ordering.send(_queue, _replica, std::forward<T>(val), std::forward<Pred>(p));
+  }
+
+  template <typename Pred>
+  bool flush(Pred&& p) {
+    return flush_output(_queue, p) && _ordering.flush(_queue, p);
+  }
+
+  void wake() {
+    _ordering.wake();
+    _queue.wake();
+  }
+};
+
+// Branch B of a fork sends its results through the fork's joining
+template <typename Queue, typename Joining, std::size_t B>
+struct joined_output {
+  Queue& _queue;
+  Joining& _joining;
+
+  template <typename T, typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    return _joining.template send<B>(_queue, std::forward<T>(val), p);
+  }
+
+  template <typename Pred>
+  bool flush(Pred&& p) {
+    return flush_output(_queue, p) && _joining.flush(_queue, p);
+  }
+
+  void wake() { _queue.wake(); }
+};
+
+// The latest output offered to the observer of a tapped stage by each replica, and how often outputs are offered.
+// A task executor schedules the observer when it had taken every output. Otherwise, it polls the slots.
+template <typename Slots>
+struct tapping {
+  Slots _slots;
+  std::size_t _every = 1;
+  task_group _observer = {};
+
+  void bind(task_group observer, task_context&) noexcept { _observer = observer; }
+};
+
+// Replicas of a tapped stage offer a copy of every _every-th output they send to its observer, through their own slot.
+// The slot only keeps the latest output, and never waits: a slow observer misses outputs instead of holding them back.
+template <typename Writer, typename Tapping, typename T>
+struct tapped_output {
+  Writer _writer;
+  Tapping& _tapping;
+  std::size_t _replica;
+  std::size_t _skipped = 0;
+  std::optional<T> _copy = {};
+
+  template <typename U, typename Pred>
+  bool push_unless(U&& val, Pred&& p) {
+    if (_skipped + 1 < _tapping._every) {
+      if (!_writer.push_unless(std::forward<U>(val), p))
+        return false;
+      _skipped++;
+      return true;
+    }
+
+    // Copied first, as sending moves it. An output that can't be sent yet keeps its copy until it is.
+    if (!_copy)
+      _copy.emplace(val);
+    if (!_writer.push_unless(std::forward<U>(val), p))
+      return false;
+
+    _skipped = 0;
+    if (_tapping._slots.offer(_replica, std::move(*_copy)))
+      _tapping._observer.notify();
+    _copy.reset();
+    return true;
+  }
+
+  template <typename Pred>
+  bool flush(Pred&& p) {
+    return flush_output(_writer, p);
+  }
+
+  void wake() { _writer.wake(); }
+};
+
+// The output of a pipeline linked to a target pipeline, whose input takes the outputs as they're sent.
+// The pipeline holds a share of its target, so the target outlives every stage pushing to it.
+// Tasks that can't push are scheduled again as a target running tasks makes progress.
+// A target running threads wouldn't schedule them, so they wait for room in its input instead.
+template <typename Target, typename T>
+class linked_output {
+  using input_t = typename Target::storage_t;
+  static_assert(std::is_same_v<input_t, T> || std::is_same_v<input_t, std::tuple<T>>,
+      "The linked pipeline must take the outputs as its input. Use tuples for multiple arguments.");
+  static_assert(accepts_many_producers<typename Target::input_queue_t>::value,
+      "The linked pipeline can be shared by many pipelines and their replicas, so its input policy must accept many "
+      "producers: spsc_ring and spsc_unbounded don't.");
+
+ public:
+  void link(std::shared_ptr<Target> target) noexcept { _target = std::move(target); }
+
+  void bind(task_group, task_context& context) {
+    _context = &context;
+    if constexpr (runs_tasks_v<typename Target::executor_t>)
+      context.link(_target->_execution.context());
+  }
+
+  // Called once every stage stopped
+  void unbind() noexcept {
+    if (_context)
+      _context->unlink();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    if (waits())
+      return push(std::move(val), [this] { return _context->_stop.load(); });
+    return push(std::move(val), p);
+  }
+
+  template <typename Pred>
+  bool flush(Pred&& p) {
+    auto stop = [this] { return _context->_stop.load(); };
+    return waits() ? flush_output(input(), stop) : flush_output(input(), p);
+  }
+
+  // Only wakes the stages of this pipeline waiting on the input: the target keeps running
+  void wake() { input().wake_producers(); }
+
+ private:
+  auto& input() noexcept { return _target->_input_queue; }
 
-  [[nodiscard]] OutputType wait_get() noexcept { return _output_queue.pop(); }
+  bool waits() const noexcept { return !runs_tasks_v<typename Target::executor_t> && _context; }
 
-  [[nodiscard]] std::optional<OutputType> try_get() noexcept {
-    if (_output_queue.empty())
-      return std::nullopt;
-    return _output_queue.pop();
+  // A single argument is moved back out of its tuple when it can't be pushed, so it can be pushed again later
+  template <typename Pred>
+  bool push(T&& val, Pred&& p) {
+    if constexpr (std::is_same_v<input_t, T>) {
+      return input().push_unless(std::move(val), p);
+    } else {
+      input_t args{std::move(val)};
+      if (input().push_unless(std::move(args), p))
+        return true;
+      val = std::get<0>(std::move(args));
+      return false;
+    }
   }
 
- protected:
-  Queue<OutputType> _output_queue;
+  std::shared_ptr<Target> _target;
+  task_context* _context = nullptr;  // Null on the thread executor
 };
 
-// Consumer
-template <template <typename...> class Queue>
-struct pipeline_output<Queue, void> {};
+// The index of the branch a callable runs, if it's a fork_branch
+template <typename Callable>
+struct branch_index {
+  static constexpr bool branch = false;
+};
+
+template <std::size_t B, typename F, bool Spread>
+struct branch_index<fork_branch<B, F, Spread>> {
+  static constexpr bool branch = true;
+  static constexpr std::size_t value = B;
+};
+
+// Placeholder for the missing input of producers and output of consumers
+struct no_queue {};
 
 //-------------------------------------------------------------------------------------------------
 // Pipeline system
 //-------------------------------------------------------------------------------------------------
 
-template <template <typename...> class Queue, typename InputTypes, typename... Stages>
+template <template <typename...> class Queue, typename Executor, typename InputTypes, typename... Stages>
 struct pipeline;
 
-template <template <typename...> class Queue, typename... InputArgs, typename... Stages>
-struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
-    : pipeline_input<Queue, jtc::type_list<InputArgs...>>,
-      pipeline_output<Queue, util::pipeline_return_t<jtc::type_list<InputArgs...>, Stages...>> {
+template <template <typename...> class Queue, typename Executor, typename... Stages>
+using input_policy_t = edge_policy<Queue, void, jtc::list_get_t<jtc::type_list<Stages...>, 0>, Executor>;
+
+template <template <typename...> class Queue, typename Executor, typename... Stages>
+using output_policy_t =
+    edge_policy<Queue, jtc::list_get_t<jtc::type_list<Stages...>, sizeof...(Stages) - 1>, void, Executor>;
+
+template <typename... Stages>
+inline constexpr bool links_output_v =
+    stage_link<jtc::list_get_t<jtc::type_list<Stages...>, sizeof...(Stages) - 1>>::value;
+
+template <template <typename...> class Queue, typename Executor, typename... InputArgs, typename... Stages>
+struct pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages...> final
+    : pipeline_input<input_policy_t<Queue, Executor, Stages...>::template queue_t, jtc::type_list<InputArgs...>>,
+      pipeline_output<output_policy_t<Queue, Executor, Stages...>::template queue_t,
+          util::pipeline_return_t<jtc::type_list<InputArgs...>, Stages...>, links_output_v<Stages...>> {
   using input_list_t = jtc::type_list<InputArgs...>;
-  using pipeline_input_t = pipeline_input<Queue, input_list_t>;
-  using pipeline_output_t = pipeline_output<Queue, util::pipeline_return_t<input_list_t, Stages...>>;
-  using tuple_t = util::intermediate_stages_tuple_t<Queue, input_list_t, Stages...>;
+  using callables = jtc::type_list<Stages...>;
+  using inputs = util::result_list_t<input_list_t, Stages...>;
+  using pipeline_input_t = pipeline_input<input_policy_t<Queue, Executor, Stages...>::template queue_t, input_list_t>;
+  using pipeline_output_t = pipeline_output<output_policy_t<Queue, Executor, Stages...>::template queue_t,
+      util::pipeline_return_t<input_list_t, Stages...>, links_output_v<Stages...>>;
+  using executor_t = Executor;
   inline static constexpr auto N = sizeof...(Stages);
 
+  // Pipelines linked to this one push straight to its input
+  template <typename, typename>
+  friend class linked_output;
+
+  // The queue between stages I and I + 1
+  template <std::size_t I>
+  using edge_t = typename edge_policy<Queue, jtc::list_get_t<callables, I>, jtc::list_get_t<callables, I + 1>,
+      Executor>::template queue_t<jtc::list_get_t<inputs, I>>;
+
+  template <std::size_t... Is>
+  static auto edge_tuple(std::index_sequence<Is...>) -> std::tuple<edge_t<Is>...>;
+
+  using tuple_t = decltype(edge_tuple(std::make_index_sequence<N - 1>{}));
+
+  // Threads are stored stage by stage, with all replicas of a stage next to each other, then the observer of its tap
+  inline static constexpr std::array<std::size_t, N> replicas = {stage_replicas_v<Stages>...};
+  inline static constexpr std::array<bool, N> tapped = {stage_tap<Stages>::value...};
+  inline static constexpr std::size_t thread_count = ((stage_replicas_v<Stages> + stage_tap<Stages>::value) + ...);
+
+  static constexpr std::size_t first_thread(std::size_t stage) noexcept {
+    std::size_t r = 0;
+    for (std::size_t i = 0; i < stage; i++)
+      r += replicas[i] + tapped[i];
+    return r;
+  }
+
+  // Data shared by the replicas of each stage
+  using outputs = jtc::list_concat_t<inputs, jtc::type_list<util::pipeline_return_t<input_list_t, Stages...>>>;
+
+  template <std::size_t I>
+  using state_t = typename stage_state<jtc::list_get_t<callables, I>, jtc::list_get_t<outputs, I>>::type;
+
+  template <std::size_t... Is>
+  static auto state_tuple(std::index_sequence<Is...>) -> std::tuple<state_t<Is>...>;
+
+  // The slots each tapped stage offers its outputs through, one per replica
+  template <std::size_t I>
+  using slots_t = util::latest_slots<jtc::list_get_t<outputs, I>, replicas[I]>;
+
+  template <std::size_t I>
+  using tap_t =
+      typename std::conditional_t<tapped[I], jtc::make_type<tapping<slots_t<I>>>, jtc::make_type<stateless>>::type;
+
+  template <std::size_t... Is>
+  static auto tap_tuple(std::index_sequence<Is...>) -> std::tuple<tap_t<Is>...>;
+
+  // How each replica of stage I reads from, or writes to, Queue. Branches of a fork run a fork_branch as Callable.
+  template <std::size_t I, typename Q>
+  decltype(auto) reader_of(Q& queue, [[maybe_unused]] std::size_t replica) noexcept {
+    if constexpr (stage_partitions<jtc::list_get_t<callables, I>>::partitioned)
+      return queue.partition(replica);
+    else if constexpr (!std::is_same_v<state_t<I>, stateless>)
+      return ordered_input<Q, state_t<I>>{queue, std::get<I>(_states), replica};
+    else if constexpr (replicas[I] > 1)
+      return replica_input<Q>{queue};
+    else
+      return queue;
+  }
+
+  template <std::size_t I, typename Callable, typename Q>
+  decltype(auto) writer_of(Q& queue, std::size_t replica) noexcept {
+    if constexpr (tapped[I]) {
+      static_assert(
+          !branch_index<Callable>::branch, "A tap can't follow a fork, as its branches send parts of each output.");
+      using writer_t = decltype(untapped_writer_of<I, Callable>(queue, replica));
+      return tapped_output<writer_t, tap_t<I>, jtc::list_get_t<outputs, I>>{
+          untapped_writer_of<I, Callable>(queue, replica), std::get<I>(_taps), replica};
+    } else {
+      return untapped_writer_of<I, Callable>(queue, replica);
+    }
+  }
+
+  template <std::size_t I, typename Callable, typename Q>
+  decltype(auto) untapped_writer_of(Q& queue, [[maybe_unused]] std::size_t replica) noexcept {
+    if constexpr (branch_index<Callable>::branch)
+      return joined_output<Q, state_t<I>, branch_index<Callable>::value>{queue, std::get<I>(_states)};
+    else if constexpr (!std::is_same_v<state_t<I>, stateless>)
+      return ordered_output<Q, state_t<I>>{queue, std::get<I>(_states), replica};
+    else
+      return queue;
+  }
+
  public:
-  pipeline(std::tuple<Stages...>&& stages) {
+  /// The queue type of every edge without tdp::via(), and of the polled output
+  template <typename T>
+  using queue_t = Queue<T>;
+
+  pipeline(std::tuple<Stages...>&& stages, Executor executor = {}) : _execution{executor, _stop} {
+    bind_partitions(stages, std::make_index_sequence<N>{});
+
     try {
       if constexpr (N > 1) {
         init_output_thread(std::move(std::get<N - 1>(stages)));
@@ -223,6 +2119,11 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
       stop_threads();
       throw;
     }
+
+    if constexpr (runs_tasks_v<Executor>) {
+      bind_tasks(std::make_index_sequence<N - 1>{});
+    }
+    _execution.run();
   }
 
   pipeline(const pipeline&) = delete;
@@ -232,17 +2133,9 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
 
   template <std::size_t I>
   void init_intermediary_threads(std::tuple<Stages...>& stages) {
-    using inputs = util::result_list_t<input_list_t, Stages...>;
     using input_t = jtc::list_get_t<inputs, I - 1>;
-    using callables = jtc::type_list<Stages...>;
-    using callable_t = jtc::list_get_t<callables, I>;
-
-    _threads[I] = std::thread(thread_worker<Queue, input_t, callable_t>{
-        std::move(std::get<I>(stages)),
-        std::get<I - 1>(_queues),
-        std::get<I>(_queues),
-        _stop,
-    });
+
+    launch<I, input_t>(std::move(std::get<I>(stages)), std::get<I - 1>(_queues), std::get<I>(_queues));
 
     if constexpr (I < N - 2) {
       init_intermediary_threads<I + 1>(stages);
@@ -252,53 +2145,35 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
   template <typename T>
   void init_output_thread(T&& last) {
     using ret_t = util::pipeline_return_t<input_list_t, Stages...>;
-    using inputs = util::result_list_t<input_list_t, Stages...>;
     using input_t = jtc::list_get_t<inputs, inputs::size - 1>;
-    using callables = jtc::type_list<Stages...>;
-    using callable_t = jtc::list_get_t<callables, N - 1>;
 
     if constexpr (std::is_same_v<ret_t, void>) {
       // Consumer
-      _threads[N - 1] = std::thread(thread_worker<Queue, input_t, callable_t>{
-          std::forward<T>(last),
-          std::get<N - 2>(_queues),
-          _stop,
-      });
+      no_queue none;
+      launch<N - 1, input_t>(std::forward<T>(last), std::get<N - 2>(_queues), none);
     } else {
       // User output
-      _threads[N - 1] = std::thread(thread_worker<Queue, input_t, callable_t>{
-          std::forward<T>(last),
-          std::get<N - 2>(_queues),
-          pipeline_output_t::_output_queue,
-          _stop,
-      });
+      launch<N - 1, input_t>(std::forward<T>(last), std::get<N - 2>(_queues), pipeline_output_t::_output_queue);
     }
   }
 
   template <typename T>
   void init_input_thread(T&& first) {
     using input_t = input_list_t;
-    using callables = jtc::type_list<Stages...>;
-    using callable_t = jtc::list_get_t<callables, 0>;
+    no_queue none;
 
     if constexpr (sizeof...(InputArgs) == 0) {
       // Producer
+      static_assert(std::is_same_v<state_t<0>, stateless>, "Producers can't be ordered, as they have no input.");
+      static_assert(!stage_partitions<jtc::list_get_t<callables, 0>>::partitioned,
+          "Producers can't be partitioned or forked, as they have no input.");
+
       if constexpr (N == 1) {
         // Producing directly to output
-        _threads[0] = std::thread(thread_worker<Queue, input_t, callable_t>{
-            std::forward<T>(first),
-            pipeline_output_t::_output_queue,
-            pipeline_input_t::_paused,
-            _stop,
-        });
+        launch<0, input_t>(std::forward<T>(first), none, pipeline_output_t::_output_queue);
       } else {
         // Producing to another thread
-        _threads[0] = std::thread(thread_worker<Queue, input_t, callable_t>{
-            std::forward<T>(first),
-            std::get<0>(_queues),
-            pipeline_input_t::_paused,
-            _stop,
-        });
+        launch<0, input_t>(std::forward<T>(first), none, std::get<0>(_queues));
       }
     } else {
       // User input
@@ -306,28 +2181,14 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
         using ret_t = util::pipeline_return_t<input_list_t, Stages...>;
         if constexpr (std::is_same_v<ret_t, void>) {
           // Consumer-only pipeline
-          _threads[0] = std::thread(thread_worker<Queue, input_t, callable_t>{
-              std::forward<T>(first),
-              pipeline_input_t::_input_queue,
-              _stop,
-          });
+          launch<0, input_t>(std::forward<T>(first), pipeline_input_t::_input_queue, none);
         } else {
           // Feeding directly to output
-          _threads[0] = std::thread(thread_worker<Queue, input_t, callable_t>{
-              std::forward<T>(first),
-              pipeline_input_t::_input_queue,
-              pipeline_output_t::_output_queue,
-              _stop,
-          });
+          launch<0, input_t>(std::forward<T>(first), pipeline_input_t::_input_queue, pipeline_output_t::_output_queue);
         }
       } else {
         // Feeding to a second thread
-        _threads[0] = std::thread(thread_worker<Queue, input_t, callable_t>{
-            std::forward<T>(first),
-            pipeline_input_t::_input_queue,
-            std::get<0>(_queues),
-            _stop,
-        });
+        launch<0, input_t>(std::forward<T>(first), pipeline_input_t::_input_queue, std::get<0>(_queues));
       }
     }
   }
@@ -335,7 +2196,145 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
  private:
   std::atomic_bool _stop = false;
   tuple_t _queues;
-  std::array<std::thread, N> _threads;
+  decltype(state_tuple(std::make_index_sequence<N>{})) _states;
+  decltype(tap_tuple(std::make_index_sequence<N>{})) _taps;
+  execution<Executor, thread_count> _execution;
+
+  // Gives the edge feeding each keyed stage a copy of its key function, before any thread runs
+  template <std::size_t... Is>
+  void bind_partitions(const std::tuple<Stages...>& stages, std::index_sequence<Is...>) {
+    (bind_partition<Is>(std::get<Is>(stages)), ...);
+  }
+
+  template <std::size_t I, typename Stage>
+  void bind_partition([[maybe_unused]] const Stage& stage) {
+    if constexpr (stage_partitions<Stage>::keyed) {
+      if constexpr (I == 0)
+        pipeline_input_t::_input_queue.bind(stage_partitions<Stage>::key(stage));
+      else
+        std::get<I - 1>(_queues).bind(stage_partitions<Stage>::key(stage));
+    }
+  }
+
+  // Starts every replica of stage I. Each one gets its own copy of the callable, or its own branch.
+  template <std::size_t I, typename Input, typename Stage, typename In, typename Out>
+  void launch(Stage&& stage, In& input, Out& output) {
+    if constexpr (stage_link<std::decay_t<Stage>>::value) {
+      pipeline_output_t::_output_queue.link(std::move(stage._target));
+      launch<I, Input>(std::move(stage._f), input, output);
+    } else if constexpr (stage_tap<std::decay_t<Stage>>::value) {
+      std::get<I>(_taps)._every = stage._every;
+      observe<I>(std::move(stage._observer));
+      launch<I, Input>(std::move(stage._f), input, output);
+    } else if constexpr (stage_branches<std::decay_t<Stage>>::value) {
+      launch_branches<I, Input>(stage_branches<std::decay_t<Stage>>::get(stage), input, output,
+          std::make_index_sequence<replicas[I]>{});
+    } else {
+      if constexpr (replicas[I] > 1) {
+        for (std::size_t r = 1; r < replicas[I]; r++)
+          start<I, Input>(stage, input, output, r);
+      }
+
+      start<I, Input>(std::forward<Stage>(stage), input, output, 0);
+    }
+  }
+
+  // Branches of a fork read shared pointers to their inputs. Only the user input is a tuple of arguments.
+  // Branches of a route read the inputs themselves, and merged producers have none.
+  template <std::size_t I, typename Input, typename Stage, typename In, typename Out, std::size_t... Bs>
+  void launch_branches(Stage&& stage, In& input, Out& output, std::index_sequence<Bs...>) {
+    constexpr bool spread = (I == 0 && sizeof...(InputArgs) != 0);
+    if constexpr (!util::is_instance_of_v<std::decay_t<Stage>, fork>)
+      (start<I, Input>(std::move(stage).template branch<Bs, spread>(), input, output, Bs), ...);
+    else
+      (start<I, typename In::element_t>(std::move(stage).template branch<Bs, spread>(), input, output, Bs), ...);
+  }
+
+  // Starts the observer of a tapped stage, which reads the latest output offered to it
+  template <std::size_t I, typename Observer>
+  void observe(Observer&& observer) {
+    using output_t = jtc::list_get_t<outputs, I>;
+    static_assert(std::is_invocable_v<Observer, output_t>, "A tap's observer must be callable with the outputs.");
+    static_assert(std::is_void_v<std::invoke_result_t<Observer, output_t>>, "A tap's observer must return void.");
+    static_assert(std::is_default_constructible_v<output_t> && std::is_copy_constructible_v<output_t>,
+        "Tapped outputs are copied into a buffer, so they must be default constructible and copyable.");
+
+    _execution.start(first_thread(I) + replicas[I], thread_worker<output_t, Observer, slots_t<I>&, void>{
+                                                        std::forward<Observer>(observer),
+                                                        std::get<I>(_taps)._slots,
+                                                        _stop,
+                                                    });
+  }
+
+  template <std::size_t I, typename Input, typename Stage, typename In, typename Out>
+  void start(Stage&& stage, In& input, Out& output, std::size_t replica) {
+    using callable_t = std::decay_t<Stage>;
+    using reader_t = decltype(reader_of<I>(input, replica));
+    using writer_t = decltype(writer_of<I, callable_t>(output, replica));
+    const auto index = first_thread(I) + replica;
+
+    if constexpr (std::is_same_v<In, no_queue>) {
+      _execution.start(index, thread_worker<Input, callable_t, void, writer_t>{
+                                  std::forward<Stage>(stage),
+                                  writer_of<I, callable_t>(output, replica),
+                                  pipeline_input_t::_paused,
+                                  _stop,
+                              });
+    } else if constexpr (std::is_same_v<Out, no_queue>) {
+      _execution.start(index, thread_worker<Input, callable_t, reader_t, void>{
+                                  std::forward<Stage>(stage),
+                                  reader_of<I>(input, replica),
+                                  _stop,
+                              });
+    } else {
+      _execution.start(index, thread_worker<Input, callable_t, reader_t, writer_t>{
+                                  std::forward<Stage>(stage),
+                                  reader_of<I>(input, replica),
+                                  writer_of<I, callable_t>(output, replica),
+                                  _stop,
+                              });
+    }
+  }
+
+  // Makes every queue schedule the tasks reading it
+  template <std::size_t... Is>
+  void bind_tasks(std::index_sequence<Is...>) {
+    if constexpr (sizeof...(InputArgs) != 0)
+      bind_readers<0>(pipeline_input_t::_input_queue);
+    else
+      pipeline_input_t::_producers = _execution.group(first_thread(0), replicas[0]);
+
+    (bind_readers<Is + 1>(std::get<Is>(_queues)), ...);
+    bind_observers(std::make_index_sequence<N>{});
+
+    if constexpr (!std::is_same_v<util::pipeline_return_t<input_list_t, Stages...>, void>)
+      pipeline_output_t::_output_queue.bind({}, _execution.context());
+  }
+
+  // Stage I reads the queue. Each replica of a partitioned stage only reads its own partition.
+  template <std::size_t I, typename Q>
+  void bind_readers(Q& queue) {
+    if constexpr (I < N) {
+      if constexpr (stage_partitions<jtc::list_get_t<callables, I>>::partitioned) {
+        for (std::size_t r = 0; r < replicas[I]; r++)
+          queue.partition(r).bind(_execution.group(first_thread(I) + r, 1), _execution.context());
+      } else {
+        queue.bind(_execution.group(first_thread(I), replicas[I]), _execution.context());
+      }
+    }
+  }
+
+  // The replicas of each tapped stage schedule its observer
+  template <std::size_t... Is>
+  void bind_observers(std::index_sequence<Is...>) {
+    (bind_observer<Is>(), ...);
+  }
+
+  template <std::size_t I>
+  void bind_observer() {
+    if constexpr (tapped[I])
+      std::get<I>(_taps).bind(_execution.group(first_thread(I) + replicas[I], 1), _execution.context());
+  }
 
   void stop_threads() {
     // Set the "stop token" flag
@@ -350,10 +2349,18 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
     // (needed in case thread fails during construction)
     util::tuple_foreach([](auto& queue) { queue.wake(); }, _queues);
 
+    // Wake the output thread, in case it's waiting on a full output queue
+    if constexpr (!std::is_same_v<util::pipeline_return_t<input_list_t, Stages...>, void>) {
+      pipeline_output_t::_output_queue.wake();
+    }
+
     // Wait for all unfinished threads to exit
-    for (auto& thread : _threads)
-      if (thread.joinable())
-        thread.join();
+    _execution.join();
+
+    // Stop being scheduled by the target of a linked output
+    if constexpr (links_output_v<Stages...>) {
+      pipeline_output_t::_output_queue.unbind();
+    }
   }
 };
 
@@ -361,12 +2368,105 @@ struct pipeline<Queue, jtc::type_list<InputArgs...>, Stages...> final
 // Execution policies
 //-------------------------------------------------------------------------------------------------
 
+// Binds the wait strategy of a queue
+template <template <typename...> class Queue, typename Wait>
+struct waiting_policy {
+  template <typename T>
+  using queue_t = Queue<T, Wait>;
+};
+
 template <template <typename...> class Queue>
-struct policy_type {};
+struct policy_type {
+  /// The same policy, waiting with another strategy. Usage: tdp::policy::queue.with<tdp::wait::busy_poll>
+  template <typename Wait>
+  static constexpr policy_type<waiting_policy<Queue, Wait>::template queue_t> with = {};
+};
+
+// Binds the capacity of a bounded queue, so it can be used as a policy
+template <template <typename, std::size_t, typename> class Queue, std::size_t Capacity>
+struct bounded_policy {
+  template <typename T, typename Wait = util::hybrid_park>
+  using queue_t = Queue<T, Capacity, Wait>;
+};
 
 template <typename T>
 using default_queue_t = util::blocking_queue<T>;
 
+// Compares the queue types instantiated by each policy, as different aliases can name the same queue
+template <typename Pipeline, typename Policy>
+struct uses_policy;
+
+template <typename Pipeline, template <typename...> class Queue>
+struct uses_policy<Pipeline, policy_type<Queue>>
+    : std::is_same<typename Pipeline::template queue_t<int>, Queue<int>> {};
+
+template <typename Pipeline, template <typename...> class Queue>
+struct uses_policy<std::unique_ptr<Pipeline>, policy_type<Queue>> : uses_policy<Pipeline, policy_type<Queue>> {};
+
+template <typename Pipeline, template <typename...> class Queue>
+struct uses_policy<std::shared_ptr<Pipeline>, policy_type<Queue>> : uses_policy<Pipeline, policy_type<Queue>> {};
+
+// Marks the policy of the next edge: stageA >> tdp::via(Policy) >> stageB
+template <template <typename...> class Queue>
+struct via_type {};
+
+template <template <typename...> class Queue>
+[[nodiscard]] constexpr auto via(policy_type<Queue>) noexcept {
+  return via_type<Queue>{};
+}
+
+//-------------------------------------------------------------------------------------------------
+// Executor selection
+//-------------------------------------------------------------------------------------------------
+
+template <typename T>
+struct is_executor : std::false_type {};
+
+template <>
+struct is_executor<thread_executor> : std::true_type {};
+
+template <>
+struct is_executor<work_stealing_executor> : std::true_type {};
+
+template <>
+struct is_executor<shared_executor> : std::true_type {};
+
+template <typename T>
+inline constexpr bool is_executor_v = is_executor<T>::value;
+
+// A thread count of 0 means one thread per hardware thread
+inline std::size_t pool_size(std::size_t threads) noexcept {
+  return (threads != 0) ? threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+[[nodiscard]] inline work_stealing_executor work_stealing(std::size_t threads) noexcept {
+  return {pool_size(threads)};
+}
+
+// A pool of threads running the stages of every pipeline registered with it.
+// Ready stages take turns on the threads: each one runs a bounded number of steps,
+// then goes back to the end of its thread's queue, behind the stages of the other pipelines.
+// It must outlive the pipelines registered with it.
+class scheduler {
+ public:
+  explicit scheduler(std::size_t threads = 0) : _pool{pool_size(threads)} {}
+
+  scheduler(const scheduler&) = delete;
+  scheduler& operator=(const scheduler&) = delete;
+
+  /// The number of threads running the stages
+  [[nodiscard]] std::size_t size() const noexcept { return _pool.size(); }
+
+ private:
+  friend shared_executor on(scheduler&) noexcept;
+
+  util::work_stealing_pool _pool;
+};
+
+[[nodiscard]] inline shared_executor on(scheduler& s) noexcept {
+  return {&s._pool};
+}
+
 //-------------------------------------------------------------------------------------------------
 // Wrapper Types
 //-------------------------------------------------------------------------------------------------
@@ -377,23 +2477,51 @@ struct wrapper_type {};
 template <typename...>
 struct null_wrapper {};
 
+// Creates a pipeline, possibly inside a wrapper
+template <typename Pipeline, template <typename...> class Wrapper, typename Stages, typename Executor>
+[[nodiscard]] auto make_pipeline(Stages&& stages, Executor executor) {
+  if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
+    return Pipeline{
+        std::move(stages),
+        executor,
+    };
+  } else {
+    return Wrapper<Pipeline>{
+        new Pipeline{
+            std::move(stages),
+            executor,
+        },
+    };
+  }
+}
+
 //-------------------------------------------------------------------------------------------------
 // Output types
 //-------------------------------------------------------------------------------------------------
 
-template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper>
+template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper,
+    typename Executor = thread_executor>
 struct output_tagged {
   OutputType _data;
+  Executor _executor;
 };
 
-template <typename OutputType, template <typename...> class Queue>
+template <typename OutputType, template <typename...> class Queue, typename Executor = thread_executor>
 struct output_with_policy {
   OutputType _data;
+  Executor _executor;
 
   template <template <typename...> class Wrapper>
   [[nodiscard]] constexpr auto operator/(wrapper_type<Wrapper>) &&  //
       noexcept(std::is_nothrow_move_constructible_v<OutputType>) {
-    return output_tagged<OutputType, Queue, Wrapper>{std::move(_data)};
+    return output_tagged<OutputType, Queue, Wrapper, Executor>{std::move(_data), _executor};
+  }
+
+  template <typename E, typename = std::enable_if_t<is_executor_v<E>>>
+  [[nodiscard]] constexpr auto operator/(E executor) &&  //
+      noexcept(std::is_nothrow_move_constructible_v<OutputType>) {
+    static_assert(std::is_same_v<Executor, thread_executor>, "A pipeline can only have one executor.");
+    return output_with_policy<OutputType, Queue, E>{std::move(_data), executor};
   }
 };
 
@@ -407,6 +2535,11 @@ struct end_type {
   [[nodiscard]] constexpr auto operator/(wrapper_type<Wrapper>) const noexcept {
     return output_tagged<end_type, default_queue_t, Wrapper>{};
   }
+
+  template <typename Executor, typename = std::enable_if_t<is_executor_v<Executor>>>
+  [[nodiscard]] constexpr auto operator/(Executor executor) const noexcept {
+    return output_with_policy<end_type, default_queue_t, Executor>{{}, executor};
+  }
 };
 
 template <typename F>
@@ -417,18 +2550,60 @@ struct consumer {
 
   template <template <typename...> class Queue>
   [[nodiscard]] constexpr auto operator/(policy_type<Queue>) && noexcept(std::is_nothrow_move_constructible_v<F>) {
-    return output_with_policy<consumer, Queue>{std::move(*this)};
+    return output_with_policy<consumer, Queue>{std::move(*this), {}};
   }
 
   template <template <typename...> class Wrapper>
   [[nodiscard]] constexpr auto operator/(wrapper_type<Wrapper>) && noexcept(std::is_nothrow_move_constructible_v<F>) {
-    return output_tagged<consumer, default_queue_t, Wrapper>{std::move(*this)};
+    return output_tagged<consumer, default_queue_t, Wrapper>{std::move(*this), {}};
+  }
+
+  template <typename Executor, typename = std::enable_if_t<is_executor_v<Executor>>>
+  [[nodiscard]] constexpr auto operator/(Executor executor) && noexcept(std::is_nothrow_move_constructible_v<F>) {
+    return output_with_policy<consumer, default_queue_t, Executor>{std::move(*this), executor};
   }
 };
 
 template <typename F>
 consumer(F) -> consumer<std::decay_t<F>>;
 
+// A consumer running a fork of consumers
+template <typename... C>
+struct broadcast : consumer<fork<C...>> {
+  constexpr explicit broadcast(C... c) noexcept(util::are_nothrow_move_constructible_v<C...>)
+      : consumer<fork<C...>>{fork<C...>{std::move(c)...}} {}
+};
+
+template <typename... C>
+broadcast(C...) -> broadcast<C...>;
+
+// The target pipeline of a linked output
+template <typename Target>
+struct into_type {
+  std::shared_ptr<Target> _target;
+
+  template <template <typename...> class Queue>
+  [[nodiscard]] auto operator/(policy_type<Queue>) && noexcept {
+    return output_with_policy<into_type, Queue>{std::move(*this), {}};
+  }
+
+  template <template <typename...> class Wrapper>
+  [[nodiscard]] auto operator/(wrapper_type<Wrapper>) && noexcept {
+    return output_tagged<into_type, default_queue_t, Wrapper>{std::move(*this), {}};
+  }
+
+  template <typename Executor, typename = std::enable_if_t<is_executor_v<Executor>>>
+  [[nodiscard]] auto operator/(Executor executor) && noexcept {
+    return output_with_policy<into_type, default_queue_t, Executor>{std::move(*this), executor};
+  }
+};
+
+template <template <typename...> class Queue, typename Executor, typename... InputArgs, typename... Stages>
+[[nodiscard]] auto into(std::shared_ptr<pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages...>> target) {
+  static_assert(sizeof...(InputArgs) != 0, "A pipeline can only be linked to one taking inputs, not to a producer.");
+  return into_type<pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages...>>{std::move(target)};
+}
+
 //-------------------------------------------------------------------------------------------------
 // Construction (intermediary) types
 //-------------------------------------------------------------------------------------------------
@@ -436,6 +2611,9 @@ consumer(F) -> consumer<std::decay_t<F>>;
 template <typename ParameterTypeList, typename... Stages>
 struct partial_pipeline;
 
+template <template <typename...> class Queue, typename ParameterTypeList, typename... Stages>
+struct partial_pipeline_via;
+
 template <typename... InputArgs, typename... Stages>
 struct partial_pipeline<jtc::type_list<InputArgs...>, Stages...> {
   partial_pipeline(std::tuple<Stages...>&& stages)  //
@@ -446,57 +2624,54 @@ struct partial_pipeline<jtc::type_list<InputArgs...>, Stages...> {
 
   std::tuple<Stages...> _stages;
 
-  template <template <typename...> class Queue = default_queue_t, template <typename...> class Wrapper = null_wrapper>
+  template <template <typename...> class Queue = default_queue_t, template <typename...> class Wrapper = null_wrapper,
+      typename Executor = thread_executor>
   [[nodiscard]] auto operator>>(end_type) && {
-    using pipeline_t = pipeline<Queue, jtc::type_list<InputArgs...>, Stages...>;
-
-    if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
-      return pipeline_t{
-          std::move(_stages),
-      };
-    } else {
-      return Wrapper<pipeline_t>{
-          new pipeline_t{
-              std::move(_stages),
-          },
-      };
-    }
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages...>;
+    return make_pipeline<pipeline_t, Wrapper>(std::move(_stages), Executor{});
   }
 
   template <template <typename...> class Queue = default_queue_t,  //
       template <typename...> class Wrapper = null_wrapper,         //
+      typename Executor = thread_executor,                         //
       typename F>
   [[nodiscard]] auto operator>>(consumer<F>&& s) && {
-    using F_ = std::decay_t<F>;
-    using arg_t = tdp::util::pipeline_return_t<jtc::type_list<InputArgs...>, Stages...>;
-    static_assert(std::is_invocable_v<F_, arg_t>, "The consumer can't be called with the pipeline stage's output");
-    static_assert(std::is_same_v<std::invoke_result_t<F_, arg_t>, void>, "A consumer must return void.");
+    return std::move(*this).template finish<Queue, Wrapper>(std::move(s), Executor{});
+  }
 
-    using pipeline_t = pipeline<Queue, jtc::type_list<InputArgs...>, Stages..., F>;
+  template <typename... C>
+  [[nodiscard]] auto operator>>(broadcast<C...>&& b) && {
+    return std::move(*this) >> static_cast<consumer<fork<C...>>&&>(b);
+  }
 
-    if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
-      return pipeline_t{
-          util::tuple_append(std::move(_stages), std::move(s._f)),
-      };
-    } else {
-      return Wrapper<pipeline_t>{
-          new pipeline_t{
-              util::tuple_append(std::move(_stages), std::move(s._f)),
-          },
-      };
-    }
+  template <typename Target>
+  [[nodiscard]] auto operator>>(into_type<Target>&& link) && {
+    return std::move(*this).template finish<default_queue_t, null_wrapper>(std::move(link), thread_executor{});
   }
 
-  template <typename OutputType, template <typename...> class Queue>
-  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue>&& output) &&  //
+  template <typename OutputType, template <typename...> class Queue, typename Executor>
+  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue, Executor>&& output) &&  //
       noexcept(util::are_nothrow_move_constructible_v<OutputType, Stages...>) {
-    return std::move(*this).template operator>><Queue>(std::move(output._data));
+    return std::move(*this).template finish<Queue, null_wrapper>(std::move(output._data), output._executor);
   }
 
-  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper>
-  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper>&& output) &&  //
+  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper,
+      typename Executor>
+  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper, Executor>&& output) &&  //
       noexcept(util::are_nothrow_move_constructible_v<OutputType, Stages...>) {
-    return std::move(*this).template operator>><Queue, Wrapper>(std::move(output._data));
+    return std::move(*this).template finish<Queue, Wrapper>(std::move(output._data), output._executor);
+  }
+
+  template <template <typename...> class Queue>
+  [[nodiscard]] constexpr auto operator>>(via_type<Queue>) &&  //
+      noexcept(util::are_nothrow_move_constructible_v<Stages...>) {
+    return partial_pipeline_via<Queue, jtc::type_list<InputArgs...>, Stages...>{std::move(_stages)};
+  }
+
+  // The last stage is wrapped into a tap_stage
+  template <typename Observer>
+  [[nodiscard]] constexpr auto operator>>(tap<Observer>&& t) && {
+    return std::move(*this).tap_last(std::move(t), std::make_index_sequence<sizeof...(Stages) - 1>{});
   }
 
   template <typename F>
@@ -507,7 +2682,7 @@ struct partial_pipeline<jtc::type_list<InputArgs...>, Stages...> {
     using arg_t = tdp::util::pipeline_return_t<jtc::type_list<InputArgs...>, Stages...>;
     static_assert(std::is_invocable_v<F_, arg_t>, "The new stage must be callable with the current pipeline output");
 
-    using ret_t = std::invoke_result_t<F_, arg_t>;
+    using ret_t = util::stage_output_t<F_, arg_t>;
     static_assert(!std::is_reference_v<ret_t>, "Pipeline stages can't return references");
     static_assert(!std::is_same_v<ret_t, void>, "To return void, use consumer threads.");
 
@@ -515,6 +2690,58 @@ struct partial_pipeline<jtc::type_list<InputArgs...>, Stages...> {
         {tdp::util::tuple_append(std::move(_stages), std::forward<F>(f))},
     };
   }
+
+ private:
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor>
+  [[nodiscard]] auto finish(end_type, Executor executor) && {
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages...>;
+    return make_pipeline<pipeline_t, Wrapper>(std::move(_stages), executor);
+  }
+
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor, typename F>
+  [[nodiscard]] auto finish(consumer<F>&& s, Executor executor) && {
+    using F_ = std::decay_t<F>;
+    using arg_t = tdp::util::pipeline_return_t<jtc::type_list<InputArgs...>, Stages...>;
+    static_assert(std::is_invocable_v<F_, arg_t>, "The consumer can't be called with the pipeline stage's output");
+    static_assert(std::is_same_v<std::invoke_result_t<F_, arg_t>, void>, "A consumer must return void.");
+
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Stages..., F>;
+    return make_pipeline<pipeline_t, Wrapper>(util::tuple_append(std::move(_stages), std::move(s._f)), executor);
+  }
+
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor,
+      typename Target>
+  [[nodiscard]] auto finish(into_type<Target>&& link, Executor executor) && {
+    return std::move(*this).template link_last<Queue, Wrapper>(
+        std::move(link), executor, std::make_index_sequence<sizeof...(Stages) - 1>{});
+  }
+
+  // The last stage is wrapped into a link_stage
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor,
+      typename Target, std::size_t... Is>
+  [[nodiscard]] auto link_last(into_type<Target>&& link, Executor executor, std::index_sequence<Is...>) && {
+    using stages_t = jtc::type_list<Stages...>;
+    using linked_t = link_stage<Target, jtc::list_get_t<stages_t, sizeof...(Is)>>;
+    using tuple_t = std::tuple<jtc::list_get_t<stages_t, Is>..., linked_t>;
+    using pipeline_t =
+        pipeline<Queue, Executor, jtc::type_list<InputArgs...>, jtc::list_get_t<stages_t, Is>..., linked_t>;
+
+    return make_pipeline<pipeline_t, Wrapper>(
+        tuple_t{std::get<Is>(std::move(_stages))...,
+            linked_t{std::get<sizeof...(Is)>(std::move(_stages)), std::move(link._target)}},
+        executor);
+  }
+
+  template <typename Observer, std::size_t... Is>
+  [[nodiscard]] constexpr auto tap_last(tap<Observer>&& t, std::index_sequence<Is...>) && {
+    using stages_t = jtc::type_list<Stages...>;
+    using tapped_t = tap_stage<Observer, jtc::list_get_t<stages_t, sizeof...(Is)>>;
+
+    return partial_pipeline<jtc::type_list<InputArgs...>, jtc::list_get_t<stages_t, Is>..., tapped_t>{
+        {std::get<Is>(std::move(_stages))...,
+            tapped_t{std::get<sizeof...(Is)>(std::move(_stages)), std::move(t._observer), t._every}},
+    };
+  }
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -537,7 +2764,7 @@ struct input_type {
 
     static_assert(std::is_invocable_v<F_, InputArgs...>, "The pipeline stage must be callable with the input.");
 
-    using ret_t = std::invoke_result_t<F_, InputArgs...>;
+    using ret_t = util::stage_output_t<F_, InputArgs...>;
     static_assert(!std::is_reference_v<ret_t>, "Pipeline stages can't return references");
     static_assert(!std::is_same_v<ret_t, void>, "To return void, use consumer threads.");
 
@@ -546,38 +2773,54 @@ struct input_type {
     };
   }
 
-  template <template <typename...> class Queue = default_queue_t,  //
-      template <typename...> class Wrapper = null_wrapper,         //
-      typename Fc>
-  [[nodiscard]] constexpr auto operator>>(consumer<Fc>&& c) const {
-    static_assert(std::is_invocable_v<Fc, InputArgs...>, "The consumer must be callable with the input.");
+  template <template <typename...> class Queue>
+  [[nodiscard]] constexpr auto operator>>(via_type<Queue>) const noexcept {
+    return partial_pipeline_via<Queue, jtc::type_list<InputArgs...>>{};
+  }
 
-    using ret_t = std::invoke_result_t<Fc, InputArgs...>;
-    static_assert(std::is_same_v<ret_t, void>, "A consumer must return void.");
+  template <typename Observer>
+  constexpr void operator>>(tap<Observer>&&) const noexcept {
+    static_assert(
+        util::dependent_bool<false, Observer>, "A tap observes the outputs of a stage. It can't follow the input.");
+  }
 
-    using pipeline_t = pipeline<default_queue_t, jtc::type_list<InputArgs...>, Fc>;
+  template <typename Target>
+  constexpr void operator>>(into_type<Target>&&) const noexcept {
+    static_assert(util::dependent_bool<false, Target>,
+        "A linked pipeline takes the outputs of a stage. To feed it directly, call its input functions.");
+  }
 
-    if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
-      return pipeline_t{
-          std::tuple<Fc>{std::move(c._f)},
-      };
-    } else {
-      return Wrapper<pipeline_t>{
-          new pipeline_t{
-              std::tuple<Fc>{std::move(c._f)},
-          },
-      };
-    }
+  template <typename Fc>
+  [[nodiscard]] constexpr auto operator>>(consumer<Fc>&& c) const {
+    return finish<default_queue_t, null_wrapper>(std::move(c), thread_executor{});
+  }
+
+  template <typename... C>
+  [[nodiscard]] constexpr auto operator>>(broadcast<C...>&& b) const {
+    return *this >> static_cast<consumer<fork<C...>>&&>(b);
+  }
+
+  template <typename OutputType, template <typename...> class Queue, typename Executor>
+  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue, Executor>&& output) const {
+    return finish<Queue, null_wrapper>(std::move(output._data), output._executor);
   }
 
-  template <typename OutputType, template <typename...> class Queue>
-  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue>&& output) const {
-    return std::move(*this).template operator>><Queue>(std::move(output._data));
+  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper,
+      typename Executor>
+  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper, Executor>&& output) const {
+    return finish<Queue, Wrapper>(std::move(output._data), output._executor);
   }
 
-  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper>
-  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper>&& output) const {
-    return std::move(*this).template operator>><Queue, Wrapper>(std::move(output._data));
+ private:
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor, typename Fc>
+  [[nodiscard]] auto finish(consumer<Fc>&& c, Executor executor) const {
+    static_assert(std::is_invocable_v<Fc, InputArgs...>, "The consumer must be callable with the input.");
+
+    using ret_t = std::invoke_result_t<Fc, InputArgs...>;
+    static_assert(std::is_same_v<ret_t, void>, "A consumer must return void.");
+
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<InputArgs...>, Fc>;
+    return make_pipeline<pipeline_t, Wrapper>(std::tuple<Fc>{std::move(c._f)}, executor);
   }
 };
 
@@ -589,7 +2832,7 @@ struct producer {
 
   static_assert(std::is_invocable_v<F>, "A producer thread must be invocable without parameters");
 
-  using produced_t = std::invoke_result_t<F>;
+  using produced_t = util::stage_output_t<F>;
   static_assert(!std::is_same_v<produced_t, void>, "A producer can't return void.");
   static_assert(!std::is_reference_v<produced_t>, "A producer's return type can't be a reference.");
 
@@ -599,7 +2842,7 @@ struct producer {
     static_assert(std::is_move_constructible_v<F_>);
     static_assert(std::is_invocable_v<F_, produced_t>, "The new stage must be callable with the producer's output");
 
-    using ret_t = std::invoke_result_t<F_, produced_t>;
+    using ret_t = util::stage_output_t<F_, produced_t>;
     static_assert(!std::is_reference_v<ret_t>, "Pipeline stages can't return references");
     static_assert(!std::is_same_v<ret_t, void>, "To return void, use consumer threads.");
 
@@ -608,62 +2851,147 @@ struct producer {
     };
   }
 
-  template <template <typename...> class Queue = default_queue_t,  //
-      template <typename...> class Wrapper = null_wrapper,         //
-      typename Fc>
-  [[nodiscard]] constexpr auto operator>>(consumer<Fc>&& c) && {
-    static_assert(std::is_invocable_v<Fc, produced_t>, "The consumer must be callable with the producer's output");
+  template <template <typename...> class Queue>
+  [[nodiscard]] constexpr auto operator>>(via_type<Queue>) && noexcept(std::is_nothrow_move_constructible_v<F>) {
+    return partial_pipeline_via<Queue, jtc::type_list<>, F>{{std::move(_f)}};
+  }
 
-    using ret_t = std::invoke_result_t<Fc, produced_t>;
-    static_assert(std::is_same_v<ret_t, void>, "A consumer must return void.");
+  template <typename Observer>
+  [[nodiscard]] constexpr auto operator>>(tap<Observer>&& t) && {
+    return producer<tap_stage<Observer, F>>{{std::move(_f), std::move(t._observer), t._every}};
+  }
 
-    using pipeline_t = pipeline<default_queue_t, jtc::type_list<>, F, Fc>;
+  template <typename Fc>
+  [[nodiscard]] constexpr auto operator>>(consumer<Fc>&& c) && {
+    return std::move(*this).template finish<default_queue_t, null_wrapper>(std::move(c), thread_executor{});
+  }
 
-    if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
-      return pipeline_t{
-          std::tuple<F, Fc>{std::move(_f), std::move(c._f)},
-      };
-    } else {
-      return Wrapper<pipeline_t>{
-          new pipeline_t{
-              std::tuple<F, Fc>{std::move(_f), std::move(c._f)},
-          },
-      };
-    }
+  template <typename... C>
+  [[nodiscard]] constexpr auto operator>>(broadcast<C...>&& b) && {
+    return std::move(*this) >> static_cast<consumer<fork<C...>>&&>(b);
   }
 
-  template <template <typename...> class Queue = default_queue_t,  //
-      template <typename...> class Wrapper = null_wrapper>
   [[nodiscard]] constexpr auto operator>>(end_type) && {
-    using pipeline_t = pipeline<default_queue_t, jtc::type_list<>, F>;
+    return std::move(*this).template finish<default_queue_t, null_wrapper>(end_type{}, thread_executor{});
+  }
 
-    if constexpr (util::is_same_template_v<Wrapper, null_wrapper>) {
-      return pipeline_t{
-          std::tuple<F>{std::move(_f)},
-      };
-    } else {
-      return Wrapper<pipeline_t>{
-          new pipeline_t{
-              std::tuple<F>{std::move(_f)},
-          },
-      };
-    }
+  template <typename Target>
+  [[nodiscard]] auto operator>>(into_type<Target>&& link) && {
+    return std::move(*this).template finish<default_queue_t, null_wrapper>(std::move(link), thread_executor{});
+  }
+
+  template <typename OutputType, template <typename...> class Queue, typename Executor>
+  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue, Executor>&& output) && {
+    return std::move(*this).template finish<Queue, null_wrapper>(std::move(output._data), output._executor);
+  }
+
+  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper,
+      typename Executor>
+  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper, Executor>&& output) && {
+    return std::move(*this).template finish<Queue, Wrapper>(std::move(output._data), output._executor);
+  }
+
+ private:
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor, typename Fc>
+  [[nodiscard]] auto finish(consumer<Fc>&& c, Executor executor) && {
+    static_assert(std::is_invocable_v<Fc, produced_t>, "The consumer must be callable with the producer's output");
+
+    using ret_t = std::invoke_result_t<Fc, produced_t>;
+    static_assert(std::is_same_v<ret_t, void>, "A consumer must return void.");
+
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<>, F, Fc>;
+    return make_pipeline<pipeline_t, Wrapper>(std::tuple<F, Fc>{std::move(_f), std::move(c._f)}, executor);
   }
 
-  template <typename OutputType, template <typename...> class Queue>
-  [[nodiscard]] auto operator>>(output_with_policy<OutputType, Queue>&& output) && {
-    return std::move(*this).template operator>><Queue>(std::move(output._data));
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor>
+  [[nodiscard]] auto finish(end_type, Executor executor) && {
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<>, F>;
+    return make_pipeline<pipeline_t, Wrapper>(std::tuple<F>{std::move(_f)}, executor);
   }
 
-  template <typename OutputType, template <typename...> class Queue, template <typename...> class Wrapper>
-  [[nodiscard]] auto operator>>(output_tagged<OutputType, Queue, Wrapper>&& output) && {
-    return std::move(*this).template operator>><Queue, Wrapper>(std::move(output._data));
+  template <template <typename...> class Queue, template <typename...> class Wrapper, typename Executor,
+      typename Target>
+  [[nodiscard]] auto finish(into_type<Target>&& link, Executor executor) && {
+    using linked_t = link_stage<Target, F>;
+    using pipeline_t = pipeline<Queue, Executor, jtc::type_list<>, linked_t>;
+    return make_pipeline<pipeline_t, Wrapper>(std::tuple<linked_t>{{std::move(_f), std::move(link._target)}}, executor);
   }
 };
 
 template <typename F>
 producer(F) -> producer<std::decay_t<F>>;
 
+template <typename... F>
+struct producers : producer<merged_producers<F...>> {
+  constexpr explicit producers(F... f) noexcept(util::are_nothrow_move_constructible_v<F...>)
+      : producer<merged_producers<F...>>{merged_producers<F...>{std::move(f)...}} {}
+};
+
+template <typename... F>
+producers(F...) -> producers<F...>;
+
+//-------------------------------------------------------------------------------------------------
+// Per-edge policy construction
+//
+// The stage following tdp::via() is wrapped into a via_stage, then appended as usual.
+//-------------------------------------------------------------------------------------------------
+
+template <template <typename...> class Queue, typename F>
+constexpr auto via_wrap(F&& f) {
+  using F_ = std::decay_t<F>;
+  static_assert(!std::is_same_v<F_, end_type>, "tdp::via() can't precede tdp::output. Use 'tdp::output / Policy'.");
+  return via_stage<Queue, F_>{std::forward<F>(f)};
+}
+
+template <template <typename...> class Queue, typename Observer>
+constexpr void via_wrap(tap<Observer>&&) {
+  static_assert(util::dependent_bool<false, Observer>,
+      "tdp::via() marks the edge feeding the next stage. Place taps before it: 'stage >> tdp::tap{f} >> tdp::via(p)'.");
+}
+
+template <template <typename...> class Queue, typename Target>
+constexpr void via_wrap(into_type<Target>&&) {
+  static_assert(util::dependent_bool<false, Target>,
+      "tdp::via() can't precede tdp::into(), as the linked pipeline's input has its own policy.");
+}
+
+template <template <typename...> class Queue, typename F>
+constexpr auto via_wrap(consumer<F>&& c) {
+  return consumer<via_stage<Queue, F>>{{std::move(c._f)}};
+}
+
+template <template <typename...> class Queue, typename... C>
+constexpr auto via_wrap(broadcast<C...>&& b) {
+  return via_wrap<Queue>(static_cast<consumer<fork<C...>>&&>(b));
+}
+
+template <template <typename...> class Queue, typename F, template <typename...> class Policy, typename Executor>
+constexpr auto via_wrap(output_with_policy<consumer<F>, Policy, Executor>&& c) {
+  return output_with_policy<consumer<via_stage<Queue, F>>, Policy, Executor>{{{std::move(c._data._f)}}, c._executor};
+}
+
+template <template <typename...> class Queue, typename F, template <typename...> class Policy,
+    template <typename...> class Wrapper, typename Executor>
+constexpr auto via_wrap(output_tagged<consumer<F>, Policy, Wrapper, Executor>&& c) {
+  return output_tagged<consumer<via_stage<Queue, F>>, Policy, Wrapper, Executor>{
+      {{std::move(c._data._f)}}, c._executor};
+}
+
+template <template <typename...> class Queue, typename... InputArgs, typename... Stages>
+struct partial_pipeline_via<Queue, jtc::type_list<InputArgs...>, Stages...> {
+  std::tuple<Stages...> _stages;
+
+  template <typename Next>
+  [[nodiscard]] constexpr auto operator>>(Next&& next) && {
+    if constexpr (sizeof...(Stages) == 0) {
+      return input_type<InputArgs...>{} >> via_wrap<Queue>(std::forward<Next>(next));
+    } else {
+      return partial_pipeline<jtc::type_list<InputArgs...>, Stages...>{std::move(_stages)}
+             >> via_wrap<Queue>(std::forward<Next>(next));
+    }
+  }
+};
+
 }  // namespace tdp::detail
 
-#endif
\ No newline at end of file
+#endif
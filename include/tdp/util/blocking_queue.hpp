@@ -8,56 +8,139 @@
 #ifndef TDP_BLOCKING_QUEUE_HPP
 #define TDP_BLOCKING_QUEUE_HPP
 
-#include <condition_variable>
+#include <algorithm>
+#include <chrono>
 #include <mutex>
 #include <optional>
-#include <queue>
+#include <deque>
+#include <iterator>
+
+#include "wait_strategies.hpp"
 
 namespace tdp::util {
 
-template <typename T>
+template <typename T, typename Wait = hybrid_park>
 class blocking_queue {
  public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = blocking_queue;
+
   void push(T val) {
     {
       std::unique_lock lock{_mutex};
-      _queue.push(std::move(val));
+      _queue.push_back(std::move(val));
+    }
+    _wait.notify_one();
+  }
+
+  // Pushes every element of [first, last) in one critical section, waking the consumer once.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return;
+    {
+      std::unique_lock lock{_mutex};
+      for (; first != last; ++first)
+        _queue.emplace_back(*first);
     }
-    _condition.notify_one();
+    _wait.notify_one();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&&) {
+    push(std::move(val));
+    return true;
+  }
+
+  bool try_push(T val) {
+    push(std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>&) {
+    push(std::move(val));
+    return true;
   }
 
   T pop() {
     std::unique_lock lock{_mutex};
-    _condition.wait(lock, [&] { return !_queue.empty(); });
+    _wait.wait(lock, [&] { return !_queue.empty(); });
     auto r = std::move(_queue.front());
-    _queue.pop();
+    _queue.pop_front();
     return r;
   }
 
   template <typename Pred>
   std::optional<T> pop_unless(Pred&& p) {
     std::unique_lock lock{_mutex};
-    _condition.wait(lock, [&] { return p() || !_queue.empty(); });
+    _wait.wait(lock, [&] { return p() || !_queue.empty(); });
 
     if (_queue.empty())
       return std::nullopt;
 
     auto r = std::move(_queue.front());
-    _queue.pop();
+    _queue.pop_front();
     return {r};
   }
 
+  // Waits like pop_unless, then moves every available element to the back of 'out', in one critical section.
+  // Returns the number of elements moved.
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    _wait.wait(lock, [&] { return p() || !_queue.empty(); });
+    return take_all(out);
+  }
+
+  // Like drain_into, but stops waiting at the deadline, returning 0 if nothing arrived
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock lock{_mutex};
+    _wait.wait_until(lock, [&] { return p() || !_queue.empty(); }, deadline);
+    return take_all(out);
+  }
+
+  // Waits like pop_unless, then moves up to n elements to 'out', in one critical section.
+  // Returns the number of elements moved.
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    _wait.wait(lock, [&] { return p() || !_queue.empty(); });
+
+    const auto last = _queue.begin() + std::min(n, _queue.size());
+    out = std::move(_queue.begin(), last, out);
+
+    const auto count = static_cast<std::size_t>(last - _queue.begin());
+    _queue.erase(_queue.begin(), last);
+    return count;
+  }
+
   bool empty() const noexcept { return _queue.empty(); }
 
   void wake() {
     { std::unique_lock lock{_mutex}; }
-    _condition.notify_all();
+    _wait.notify_all();
   }
 
+  // Pushes never wait
+  void wake_producers() noexcept {}
+
  private:
-  std::queue<T> _queue;
+  std::size_t take_all(std::deque<T>& out) {
+    const auto n = _queue.size();
+    if (out.empty()) {
+      out.swap(_queue);
+    } else {
+      std::move(_queue.begin(), _queue.end(), std::back_inserter(out));
+      _queue.clear();
+    }
+    return n;
+  }
+
+  std::deque<T> _queue;
   std::mutex _mutex;
-  std::condition_variable _condition;
+  Wait _wait;
 };
 
 }  // namespace tdp::util
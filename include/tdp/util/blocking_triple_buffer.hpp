@@ -9,15 +9,21 @@
 #define TDP_BLOCKING_TRIPLE_BUFFER_HPP
 
 #include <array>
-#include <condition_variable>
+#include <chrono>
+#include <deque>
 #include <mutex>
 #include <optional>
 
+#include "wait_strategies.hpp"
+
 namespace tdp::util {
 
-template <typename T>
+template <typename T, typename Wait = hybrid_park>
 class blocking_triple_buffer {
  public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = blocking_triple_buffer;
+
   void push(T val) {
     {
       std::unique_lock lock{_mutex};
@@ -25,43 +31,114 @@ class blocking_triple_buffer {
       std::swap(_in, _buf);
       available = true;
     }
-    _condition.notify_one();
+    _wait.notify_one();
   }
 
-  T pop() {
+  // Only the last element survives, so the range is written to the same buffer and published once.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return;
     {
       std::unique_lock lock{_mutex};
-      _condition.wait(lock, [&] { return available; });
-      std::swap(_out, _buf);
-      available = false;
+      for (; first != last; ++first)
+        _buffer[_in] = T(*first);
+      std::swap(_in, _buf);
+      available = true;
     }
+    _wait.notify_one();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&&) {
+    push(std::move(val));
+    return true;
+  }
+
+  bool try_push(T val) {
+    push(std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>&) {
+    push(std::move(val));
+    return true;
+  }
+
+  // The value is moved while locked, so concurrent consumers never read the same buffer
+  T pop() {
+    std::unique_lock lock{_mutex};
+    _wait.wait(lock, [&] { return available; });
+    std::swap(_out, _buf);
+    available = false;
     return std::move(_buffer[_out]);
   }
 
   template <typename Pred>
   std::optional<T> pop_unless(Pred&& p) {
-    {
-      std::unique_lock lock{_mutex};
-      _condition.wait(lock, [&] { return p() || available; });
+    std::unique_lock lock{_mutex};
+    _wait.wait(lock, [&] { return p() || available; });
+    return take();
+  }
+
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    _wait.wait(lock, [&] { return p() || available; });
+    return take_into(out);
+  }
 
-      if (!available)
-        return std::nullopt;
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock lock{_mutex};
+    _wait.wait_until(lock, [&] { return p() || available; }, deadline);
+    return take_into(out);
+  }
 
-      std::swap(_out, _buf);
-      available = false;
-    }
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    if (n == 0)
+      return 0;
 
-    return std::move(_buffer[_out]);
+    auto val = pop_unless(std::forward<Pred>(p));
+    if (!val)
+      return 0;
+
+    *out = std::move(*val);
+    ++out;
+    return 1;
   }
 
   bool empty() const noexcept { return !available; }
 
   void wake() {
     { std::unique_lock lock{_mutex}; }
-    _condition.notify_all();
+    _wait.notify_all();
   }
 
+  // Pushes never wait
+  void wake_producers() noexcept {}
+
  private:
+  // Takes the latest value, if there's one. Called with the lock held.
+  std::optional<T> take() {
+    if (!available)
+      return std::nullopt;
+
+    std::swap(_out, _buf);
+    available = false;
+    return std::move(_buffer[_out]);
+  }
+
+  std::size_t take_into(std::deque<T>& out) {
+    auto val = take();
+    if (!val)
+      return 0;
+    out.push_back(std::move(*val));
+    return 1;
+  }
+
   std::array<T, 3> _buffer;  // TODO: aligned_storage_t to prevent default construction?
   bool available = false;
   std::size_t _in = 0;
@@ -69,7 +146,7 @@ class blocking_triple_buffer {
   std::size_t _out = 2;
 
   std::mutex _mutex;
-  std::condition_variable _condition;
+  Wait _wait;
 };
 
 }  // namespace tdp::util
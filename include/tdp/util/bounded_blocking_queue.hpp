@@ -0,0 +1,204 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// bounded_blocking_queue.hpp - A bounded blocking queue implementation, with backpressure
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_BOUNDED_BLOCKING_QUEUE_HPP
+#define TDP_BOUNDED_BLOCKING_QUEUE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <deque>
+#include <iterator>
+
+#include "wait_strategies.hpp"
+
+namespace tdp::util {
+
+template <typename T, std::size_t Capacity, typename Wait = hybrid_park>
+class bounded_blocking_queue {
+  static_assert(Capacity > 0, "A bounded queue must be able to store at least one element.");
+
+ public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = bounded_blocking_queue;
+
+  void push(T val) {
+    push_unless(std::move(val), [] { return false; });
+  }
+
+  // Waits for space until p() holds. On failure, val is left untouched, so it can be pushed again later.
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    {
+      std::unique_lock lock{_mutex};
+      _not_full.wait(lock, [&] { return p() || has_space(); });
+
+      if (!has_space())
+        return false;
+
+      _queue.push_back(std::move(val));
+    }
+    _not_empty.notify_one();
+    return true;
+  }
+
+  // Pushes as many elements as fit in each critical section, waiting for space between them.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    while (first != last) {
+      {
+        std::unique_lock lock{_mutex};
+        _not_full.wait(lock, [&] { return has_space(); });
+        for (; first != last && has_space(); ++first)
+          _queue.emplace_back(*first);
+      }
+      _not_empty.notify_one();
+    }
+  }
+
+  bool try_push(T val) {
+    return push_unless(std::move(val), [] { return true; });
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>& timeout) {
+    {
+      std::unique_lock lock{_mutex};
+      const auto deadline = std::chrono::steady_clock::now() + timeout;
+      if (!_not_full.wait_until(lock, [&] { return has_space(); }, deadline))
+        return false;
+
+      _queue.push_back(std::move(val));
+    }
+    _not_empty.notify_one();
+    return true;
+  }
+
+  T pop() {
+    std::optional<T> r;
+    {
+      std::unique_lock lock{_mutex};
+      _not_empty.wait(lock, [&] { return !_queue.empty(); });
+      r.emplace(std::move(_queue.front()));
+      _queue.pop_front();
+    }
+    _not_full.notify_one();
+    return std::move(*r);
+  }
+
+  template <typename Pred>
+  std::optional<T> pop_unless(Pred&& p) {
+    std::optional<T> r;
+    {
+      std::unique_lock lock{_mutex};
+      _not_empty.wait(lock, [&] { return p() || !_queue.empty(); });
+
+      if (_queue.empty())
+        return std::nullopt;
+
+      r.emplace(std::move(_queue.front()));
+      _queue.pop_front();
+    }
+    _not_full.notify_one();
+    return r;
+  }
+
+  // Like after a pop, the consumer works on the first drained element. The others keep their space until it drains
+  // again, so the batch of a stage counts towards the capacity of its input.
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    release();
+    _not_empty.wait(lock, [&] { return p() || !_queue.empty(); });
+    return take_all(out);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock lock{_mutex};
+    release();
+    _not_empty.wait_until(lock, [&] { return p() || !_queue.empty(); }, deadline);
+    return take_all(out);
+  }
+
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    std::size_t count;
+    {
+      std::unique_lock lock{_mutex};
+      _not_empty.wait(lock, [&] { return p() || !_queue.empty(); });
+
+      const auto last = _queue.begin() + std::min(n, _queue.size());
+      out = std::move(_queue.begin(), last, out);
+
+      count = static_cast<std::size_t>(last - _queue.begin());
+      _queue.erase(_queue.begin(), last);
+    }
+    _not_full.notify_all();
+    return count;
+  }
+
+  bool empty() const noexcept { return _queue.empty(); }
+
+  // Waits for space until p() holds or the deadline passes. The space stays only while nothing else pushes.
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_for_space(Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    std::unique_lock lock{_mutex};
+    _not_full.wait_until(lock, [&] { return p() || has_space(); }, deadline);
+    return has_space();
+  }
+
+  void wake() {
+    { std::unique_lock lock{_mutex}; }
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+  // Makes waiting pushes check their predicate again, without waking the consumer
+  void wake_producers() {
+    { std::unique_lock lock{_mutex}; }
+    _not_full.notify_all();
+  }
+
+ private:
+  bool has_space() const noexcept { return _queue.size() + _drained < Capacity; }
+
+  void release() {
+    if (_drained != 0) {
+      _drained = 0;
+      _not_full.notify_all();
+    }
+  }
+
+  std::size_t take_all(std::deque<T>& out) {
+    const auto n = _queue.size();
+    if (n != 0) {
+      _drained = n - 1;
+      _not_full.notify_one();
+    }
+
+    if (out.empty()) {
+      out.swap(_queue);
+    } else {
+      std::move(_queue.begin(), _queue.end(), std::back_inserter(out));
+      _queue.clear();
+    }
+    return n;
+  }
+
+  std::deque<T> _queue;
+  std::size_t _drained = 0;  // Taken by the last drain, still holding their space
+  std::mutex _mutex;
+  Wait _not_empty;
+  Wait _not_full;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -0,0 +1,187 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// broadcast_queue.hpp - A set of queues, each receiving a shared pointer to every element
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_BROADCAST_QUEUE_HPP
+#define TDP_BROADCAST_QUEUE_HPP
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tdp::util {
+
+//---------------------------------------------------------------------------------------------------------------------
+// broadcast_queue<T, Queue, Branches>
+//
+// Holds Branches queues of type Queue, each read by a single consumer through partition(i).
+// Each element pushed to it is moved into a std::shared_ptr<const T>, and a copy of that pointer goes to every queue.
+// Pushes are serialized, so all queues receive the elements in the same order.
+//
+// When a queue can't take an element before p() holds, push_unless() keeps the element, and sends it to the remaining
+// queues before pushing anything else. flush() sends it without pushing a new element.
+//
+// try_push() and push_for() only take an element when every queue has room for it, so they never wait on a partial
+// send. Bounded queues wait for room through wait_for_space(); queues without it are taken as always having room.
+// wake() is only called when the pipeline stops: waiting pushes give up, and later ones drop their elements.
+// Pipelines linked into the one it belongs to call wake_producers() when they stop, which keeps it running.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename Queue, typename = void>
+struct has_space_wait : std::false_type {};
+
+template <typename Queue>
+struct has_space_wait<Queue, std::void_t<decltype(std::declval<Queue&>().wait_for_space(
+                                 std::declval<bool (*)()>(), std::chrono::steady_clock::time_point{}))>>
+    : std::true_type {};
+
+template <typename T, typename Queue, std::size_t Branches>
+class broadcast_queue {
+  static_assert(Branches > 0, "A broadcast queue must have at least one branch.");
+
+ public:
+  using element_t = std::shared_ptr<const T>;
+
+  Queue& partition(std::size_t i) noexcept { return _queues[i]; }
+
+  void push(T val) {
+    auto stopped = [&] { return _stopped.load(); };
+    std::unique_lock lock{_mutex};
+    if (!finish(stopped))
+      return;
+    _partial.emplace(std::make_shared<const T>(std::move(val)), 0);
+    finish(stopped);
+  }
+
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    std::vector<element_t> elements;
+    for (; first != last; ++first)
+      elements.push_back(std::make_shared<const T>(*first));
+
+    std::unique_lock lock{_mutex};
+    if (!finish([&] { return _stopped.load(); }))
+      return;
+    for (auto& queue : _queues)
+      queue.push_range(elements.begin(), elements.end());
+  }
+
+  // Returns false, leaving val untouched, if an element kept by a previous call still can't be sent before p() holds
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    std::unique_lock lock{_mutex};
+    if (!finish(p))
+      return false;
+
+    _partial.emplace(std::make_shared<const T>(std::move(val)), 0);
+    finish(p);
+    return true;
+  }
+
+  template <typename Pred>
+  bool flush(Pred&& p) {
+    std::unique_lock lock{_mutex};
+    return finish(p);
+  }
+
+  bool try_push(T val) {
+    std::unique_lock lock{_mutex};
+    if (!ready([] { return true; }, std::chrono::steady_clock::now()))
+      return false;
+
+    send_all(std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>& timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock lock{_mutex};
+    if (!ready([&] { return _stopped.load(); }, deadline) || _stopped)
+      return false;
+
+    send_all(std::move(val));
+    return true;
+  }
+
+  bool empty() const noexcept {
+    for (auto& queue : _queues)
+      if (!queue.empty())
+        return false;
+    return true;
+  }
+
+  void wake() {
+    _stopped = true;
+    for (auto& queue : _queues)
+      queue.wake();
+  }
+
+  // Makes waiting pushes check their predicate again. Unlike wake(), the queue keeps taking elements.
+  void wake_producers() {
+    for (auto& queue : _queues)
+      queue.wake_producers();
+  }
+
+ private:
+  struct partial_push {
+    element_t _element;
+    std::size_t _next;
+
+    partial_push(element_t element, std::size_t next) : _element{std::move(element)}, _next{next} {}
+  };
+
+  // Sends the kept element to the queues that didn't take it yet. Returns whether there's none left.
+  template <typename Pred>
+  bool finish(Pred&& p) {
+    if (!_partial)
+      return true;
+
+    for (auto& i = _partial->_next; i < Branches; i++) {
+      auto element = _partial->_element;
+      if (!_queues[i].push_unless(std::move(element), p))
+        return false;
+    }
+    _partial.reset();
+    return true;
+  }
+
+  // Whether an element can go to every queue, waiting for room until p() holds or the deadline passes.
+  // Only this queue pushes to them, so the room of a queue can't be lost while waiting for the next one.
+  template <typename Pred, typename Clock, typename Duration>
+  bool ready(Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    if (!finish([] { return true; }))
+      return false;
+
+    if constexpr (has_space_wait<Queue>::value) {
+      for (auto& queue : _queues)
+        if (!queue.wait_for_space(p, deadline))
+          return false;
+    }
+    return true;
+  }
+
+  void send_all(T&& val) {
+    _partial.emplace(std::make_shared<const T>(std::move(val)), 0);
+    finish([] { return true; });
+  }
+
+  std::mutex _mutex;
+  std::array<Queue, Branches> _queues;
+  std::optional<partial_push> _partial;
+  std::atomic_bool _stopped = false;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -8,8 +8,18 @@
 #ifndef TDP_HELPERS_HPP
 #define TDP_HELPERS_HPP
 
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <thread>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
 
 #include "type_list.hpp"
 
@@ -30,20 +40,52 @@ constexpr void tuple_foreach_impl(F&& f, Tuple&& tuple, std::index_sequence<Is..
   (((void)std::invoke(std::forward<F>(f), std::get<Is>(std::forward<Tuple>(tuple)))), ...);
 }
 
+// Hidden implementation for emits_many_v
+template <typename Callable, typename = void>
+struct emits_many : std::false_type {};
+
+template <typename Callable>
+struct emits_many<Callable, std::enable_if_t<std::remove_reference_t<Callable>::emits_many>> : std::true_type {};
+
+// The type of each value held by an optional or a range
+template <typename Result>
+struct emitted_value {
+  using type = std::decay_t<decltype(*std::begin(std::declval<Result&>()))>;
+};
+
+template <typename T>
+struct emitted_value<std::optional<T>> {
+  using type = T;
+};
+
+// Hidden implementation for stage_output_t
+template <bool Many, typename Callable, typename... Args>
+struct stage_output {
+  using type = std::invoke_result_t<Callable, Args...>;
+};
+
+template <typename Callable, typename... Args>
+struct stage_output<true, Callable, Args...> {
+  using type = typename emitted_value<std::decay_t<std::invoke_result_t<Callable, Args...>>>::type;
+};
+
+template <typename Callable, typename... Args>
+using stage_output_t = typename stage_output<emits_many<Callable>::value, Callable, Args...>::type;
+
 // Hidden implementation for pipeline_return_t
 template <typename Input, typename... Callables>
 struct pipeline_return;
 
 template <typename... InputArgs, typename Callable, typename... Callables>
 struct pipeline_return<jtc::type_list<InputArgs...>, Callable, Callables...>
-    : pipeline_return<jtc::type_list<std::invoke_result_t<Callable, InputArgs...>>, Callables...> {};
+    : pipeline_return<jtc::type_list<stage_output_t<Callable, InputArgs...>>, Callables...> {};
 
 template <typename... InputArgs, typename Callable>
 struct pipeline_return<jtc::type_list<InputArgs...>, Callable> {
-  using type = std::invoke_result_t<Callable, InputArgs...>;
+  using type = stage_output_t<Callable, InputArgs...>;
 };
 
-// Hidden implementation for intermediate_stages_tuple_t
+// Hidden implementation for result_list_t
 
 template <typename Input, typename... Callables>
 struct result_list;
@@ -58,13 +100,13 @@ struct result_list<jtc::type_list<InputArgs...>, Callable> {
 
 template <typename... InputArgs, typename Callable, typename... Callables>
 struct result_list<jtc::type_list<InputArgs...>, Callable, Callables...> {
-  using first_t = std::invoke_result_t<Callable, InputArgs...>;
+  using first_t = stage_output_t<Callable, InputArgs...>;
   using type = jtc::list_concat_t<jtc::type_list<first_t>, result_list_t<first_t, Callables...>>;
 };
 
 template <typename Input, typename Callable, typename... Callables>
 struct result_list<Input, Callable, Callables...> {
-  using res_t = std::invoke_result_t<Callable, Input>;
+  using res_t = stage_output_t<Callable, Input>;
   using type = jtc::list_concat_t<jtc::type_list<res_t>, result_list_t<res_t, Callables...>>;
 };
 
@@ -73,19 +115,6 @@ struct result_list<Input, Callable> {
   using type = jtc::type_list<>;
 };
 
-template <template <typename...> typename Queue, typename ResultList>
-struct tuple_instance;
-
-template <template <typename...> typename Queue, typename... Results>
-struct tuple_instance<Queue, jtc::type_list<Results...>> {
-  using type = std::tuple<Queue<Results>...>;
-};
-
-template <template <typename...> typename Queue, typename Input, typename... Callables>
-struct intermediate_stages_tuple {
-  using type = typename tuple_instance<Queue, result_list_t<Input, Callables...>>::type;
-};
-
 }  // namespace detail
 
 //---------------------------------------------------------------------------------------------------------------------
@@ -145,14 +174,28 @@ template <typename Input, typename... Callables>
 using pipeline_return_t = typename detail::pipeline_return<Input, Callables...>::type;
 
 //---------------------------------------------------------------------------------------------------------------------
-// Returns the tuple type with Queues
+// result_list_t<Input, Callables...>
+//
+// The list of types passed between Callables, i.e. the output types of all of them, except the last.
 //---------------------------------------------------------------------------------------------------------------------
 
-template <template <typename...> typename Queue, typename Input, typename... Callables>
-using intermediate_stages_tuple_t = typename detail::intermediate_stages_tuple<Queue, Input, Callables...>::type;
-
 using detail::result_list_t;
 
+//---------------------------------------------------------------------------------------------------------------------
+// emits_many_v<Callable> and stage_output_t<Callable, Args...>
+//
+// Most stages send their return value to the next one. A stage can instead send any number of outputs per call,
+// by declaring `static constexpr bool emits_many = true;` and returning a std::optional or a range:
+// each engaged value, or each element, is sent separately.
+//
+// stage_output_t is the type of each output sent by a Callable called with Args.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename Callable>
+inline constexpr bool emits_many_v = detail::emits_many<Callable>::value;
+
+using detail::stage_output_t;
+
 //---------------------------------------------------------------------------------------------------------------------
 // Determines if a class is a specialization of a template
 //
@@ -168,6 +211,24 @@ struct is_instance_of<Template<Args...>, Template> : std::bool_constant<true> {}
 template <typename Typename, template <typename...> typename Template>
 inline constexpr bool is_instance_of_v = is_instance_of<Typename, Template>::value;
 
+//---------------------------------------------------------------------------------------------------------------------
+// for_each_output(result, f)
+//
+// Calls f with each output held by the result of a stage that emits many: an optional's value, or a range's elements.
+// Outputs are moved into f.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename Result, typename F>
+void for_each_output(Result&& result, F&& f) {
+  if constexpr (is_instance_of_v<std::decay_t<Result>, std::optional>) {
+    if (result)
+      std::invoke(f, std::move(*result));
+  } else {
+    for (auto&& output : result)
+      std::invoke(f, std::move(output));
+  }
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 // Determines whether two class templates are the same
 //
@@ -183,6 +244,37 @@ struct is_same_template<T, T> : std::bool_constant<true> {};
 template <template <typename...> typename T1, template <typename...> typename T2>
 inline constexpr bool is_same_template_v = is_same_template<T1, T2>::value;
 
+//---------------------------------------------------------------------------------------------------------------------
+// Cache line size, used to avoid false sharing between producer and consumer indices
+//
+// std::hardware_destructive_interference_size isn't available (or stable) in every supported compiler.
+//---------------------------------------------------------------------------------------------------------------------
+
+inline constexpr std::size_t cache_line_size = 64;
+
+//---------------------------------------------------------------------------------------------------------------------
+// Pause functions for busy-waiting loops
+//
+// cpu_relax() hints the processor that the calling thread is spinning.
+// thread_yield() gives the rest of the time slice back to the OS scheduler.
+//---------------------------------------------------------------------------------------------------------------------
+
+inline void cpu_relax() noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#else
+  std::this_thread::yield();
+#endif
+}
+
+inline void thread_yield() noexcept {
+  std::this_thread::yield();
+}
+
 //---------------------------------------------------------------------------------------------------------------------
 // Boolean constants for dependent scopes (to use on static_assert's)
 //---------------------------------------------------------------------------------------------------------------------
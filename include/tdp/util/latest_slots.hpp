@@ -0,0 +1,74 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// latest_slots.hpp - The latest value of each of a set of producers, polled by a single consumer
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_LATEST_SLOTS_HPP
+#define TDP_LATEST_SLOTS_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <thread>
+
+#include "helpers.hpp"
+#include "lock_free_triple_buffer.hpp"
+#include "wait_strategies.hpp"
+
+namespace tdp::util {
+
+//---------------------------------------------------------------------------------------------------------------------
+// latest_slots<T, Slots>
+//
+// Holds a lock-free triple buffer for each of Slots producers, where offer(i, val) replaces the latest value of i.
+// Offering never waits, and wakes no one: it's one atomic exchange on a slot only shared with the consumer.
+// It returns whether the consumer had taken the previous value, for producers that must schedule it.
+// Otherwise, the consumer polls the slots, sleeping longer between checks while they stay empty.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename T, std::size_t Slots>
+class latest_slots {
+  static_assert(Slots > 0, "There must be at least one slot.");
+
+  static constexpr auto min_sleep = std::chrono::microseconds(50);
+  static constexpr auto max_sleep = std::chrono::microseconds(1000);
+
+  struct alignas(cache_line_size) slot {
+    lock_free_triple_buffer<T, yield_wait> buffer;
+  };
+
+ public:
+  bool offer(std::size_t i, T val) { return _slots[i].buffer.offer(std::move(val)); }
+
+  // Takes the latest value of every slot, polling them until there's one or p() holds
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    for (auto sleep = min_sleep;; sleep = std::min(sleep * 2, max_sleep)) {
+      std::size_t n = 0;
+      for (auto& s : _slots)
+        n += s.buffer.drain_into(out, [] { return true; });
+
+      if (n != 0 || p())
+        return n;
+      std::this_thread::sleep_for(sleep);
+    }
+  }
+
+  bool empty() const noexcept {
+    return std::all_of(_slots.begin(), _slots.end(), [](const slot& s) { return s.buffer.empty(); });
+  }
+
+  // The consumer never sleeps for long, so there's no one to wake
+  void wake() noexcept {}
+
+ private:
+  std::array<slot, Slots> _slots;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -0,0 +1,270 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// lock_free_ring_buffer.hpp - A bounded, lock-free, single-producer single-consumer queue
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_LOCK_FREE_RING_BUFFER_HPP
+#define TDP_LOCK_FREE_RING_BUFFER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <new>
+#include <optional>
+
+#include "bounded_blocking_queue.hpp"
+#include "helpers.hpp"
+#include "wait_strategies.hpp"
+
+namespace tdp::util {
+
+template <typename T, std::size_t Capacity, typename Wait = hybrid_park>
+class lock_free_ring_buffer {
+  static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "The ring buffer capacity must be a power of two.");
+  static_assert(std::atomic<std::size_t>::is_always_lock_free, "This queue should be lock-free.");
+
+  static constexpr std::size_t mask = Capacity - 1;
+
+  struct alignas(T) slot {
+    std::byte data[sizeof(T)];
+  };
+
+ public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = bounded_blocking_queue<T, Capacity, Wait>;
+
+  lock_free_ring_buffer() : _slots{std::make_unique<slot[]>(Capacity)} {}
+  lock_free_ring_buffer(const lock_free_ring_buffer&) = delete;
+  lock_free_ring_buffer& operator=(const lock_free_ring_buffer&) = delete;
+
+  ~lock_free_ring_buffer() {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+    for (auto head = _read.load(std::memory_order_relaxed); head != tail; ++head)
+      element(head).~T();
+  }
+
+  void push(T val) {
+    push_unless(std::move(val), [] { return false; });
+  }
+
+  // Waits for space until p() holds. On failure, val is left untouched, so it can be pushed again later.
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+
+    if (!has_space(tail)) {
+      _not_full.wait([&] { return has_space(tail) || p(); });
+      if (!has_space(tail))
+        return false;
+    }
+
+    emplace(tail, std::move(val));
+    return true;
+  }
+
+  // Writes as many elements as fit, publishing them with a single index update, then waits for more space.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    auto tail = _tail.load(std::memory_order_relaxed);
+
+    while (first != last) {
+      _not_full.wait([&] { return has_space(tail); });
+
+      for (; first != last && has_space(tail); ++first, ++tail)
+        new (&_slots[tail & mask]) T(*first);
+
+      _tail.store(tail, std::memory_order_release);
+      _not_empty.notify_one();
+    }
+  }
+
+  bool try_push(T val) {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+
+    if (!has_space(tail))
+      return false;
+
+    emplace(tail, std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>& timeout) {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+
+    if (!_not_full.wait_until([&] { return has_space(tail); }, std::chrono::steady_clock::now() + timeout))
+      return false;
+
+    emplace(tail, std::move(val));
+    return true;
+  }
+
+  T pop() {
+    const auto head = release();
+    _not_empty.wait([&] { return has_data(head); });
+    return take(head);
+  }
+
+  template <typename Pred>
+  std::optional<T> pop_unless(Pred&& p) {
+    const auto head = release();
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return std::nullopt;
+
+    return take(head);
+  }
+
+  // Like after a pop, the consumer works on the first drained element. The others keep their space until it drains
+  // again, so the batch of a stage counts towards the capacity of its input.
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    const auto head = release();
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return 0;
+
+    return take_all(head, out);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    const auto head = release();
+
+    _not_empty.wait_until([&] { return has_data(head) || p(); }, deadline);
+    if (!has_data(head))
+      return 0;
+
+    return take_all(head, out);
+  }
+
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    const auto head = release();
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return 0;
+
+    _tail_cache = _tail.load(std::memory_order_acquire);
+    const auto last = head + std::min(n, _tail_cache - head);
+    for (auto idx = head; idx != last; ++idx, ++out) {
+      auto& e = element(idx);
+      *out = std::move(e);
+      e.~T();
+    }
+
+    publish(last);
+    return last - head;
+  }
+
+  bool empty() const noexcept { return _read.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+  // Producer side, like the pushes: waits for space until p() holds or the deadline passes
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_for_space(Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+    if (has_space(tail))
+      return true;
+
+    _not_full.wait_until([&] { return has_space(tail) || p(); }, deadline);
+    return has_space(tail);
+  }
+
+  void wake() {
+    _not_empty.notify_all();
+    _not_full.notify_all();
+  }
+
+  // Makes a waiting push check its predicate again, without waking the consumer
+  void wake_producers() { _not_full.notify_all(); }
+
+ private:
+  T& element(std::size_t idx) noexcept { return *std::launder(reinterpret_cast<T*>(&_slots[idx & mask])); }
+
+  // Producer side: only reloads the consumer's index when the cached one says the ring is full
+  bool has_space(std::size_t tail) noexcept {
+    if (tail - _head_cache != Capacity)
+      return true;
+    _head_cache = _head.load(std::memory_order_acquire);
+    return tail - _head_cache != Capacity;
+  }
+
+  // Consumer side: only reloads the producer's index when the cached one says the ring is empty
+  bool has_data(std::size_t head) noexcept {
+    if (head != _tail_cache)
+      return true;
+    _tail_cache = _tail.load(std::memory_order_acquire);
+    return head != _tail_cache;
+  }
+
+  void emplace(std::size_t tail, T&& val) {
+    new (&_slots[tail & mask]) T(std::move(val));
+    _tail.store(tail + 1, std::memory_order_release);
+    _not_empty.notify_one();
+  }
+
+  std::size_t take_all(std::size_t head, std::deque<T>& out) {
+    const auto tail = _tail_cache = _tail.load(std::memory_order_acquire);
+    for (auto idx = head; idx != tail; ++idx) {
+      auto& e = element(idx);
+      out.push_back(std::move(e));
+      e.~T();
+    }
+
+    _read.store(tail, std::memory_order_release);
+    _head.store(head + 1, std::memory_order_release);
+    _not_full.notify_one();
+    return tail - head;
+  }
+
+  T take(std::size_t head) {
+    auto& e = element(head);
+    T r = std::move(e);
+    e.~T();
+    publish(head + 1);
+    return r;
+  }
+
+  // Consumer side: moves both indexes past the taken elements, handing their space to the producer
+  void publish(std::size_t head) noexcept {
+    _read.store(head, std::memory_order_release);
+    _head.store(head, std::memory_order_release);
+    _not_full.notify_one();
+  }
+
+  // Consumer side: hands the space of the last drain to the producer, returning the next index to read
+  std::size_t release() noexcept {
+    const auto read = _read.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_relaxed) != read) {
+      _head.store(read, std::memory_order_release);
+      _not_full.notify_one();
+    }
+    return read;
+  }
+
+  std::unique_ptr<slot[]> _slots;
+
+  // Consumer-owned line: the index of the space given back, the next index to read, and the last seen write index
+  alignas(cache_line_size) std::atomic<std::size_t> _head = 0;
+  std::atomic<std::size_t> _read = 0;
+  std::size_t _tail_cache = 0;
+
+  // Producer-owned line: write index and the last seen read index
+  alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+  std::size_t _head_cache = 0;
+
+  Wait _not_empty;
+  Wait _not_full;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -0,0 +1,254 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// lock_free_segmented_queue.hpp - An unbounded, lock-free, single-producer single-consumer queue
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_LOCK_FREE_SEGMENTED_QUEUE_HPP
+#define TDP_LOCK_FREE_SEGMENTED_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <new>
+#include <optional>
+
+#include "blocking_queue.hpp"
+#include "helpers.hpp"
+#include "wait_strategies.hpp"
+
+namespace tdp::util {
+
+// The queue is a linked list of fixed-size segments.
+// The producer appends segments as needed, and the consumer hands the drained ones back for reuse.
+// Memory is only allocated when a burst outgrows the segments already in use.
+template <typename T, typename Wait = hybrid_park>
+class lock_free_segmented_queue {
+  static_assert(std::atomic<std::size_t>::is_always_lock_free, "This queue should be lock-free.");
+
+  static constexpr std::size_t segment_size = 256;  // Must be a power of two
+
+  static constexpr std::size_t mask = segment_size - 1;
+
+  struct alignas(T) slot {
+    std::byte data[sizeof(T)];
+  };
+
+  struct segment {
+    slot slots[segment_size];
+    std::atomic<segment*> next = nullptr;
+  };
+
+ public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = blocking_queue<T, Wait>;
+
+  lock_free_segmented_queue() : _head_segment{new segment}, _tail_segment{_head_segment} {}
+  lock_free_segmented_queue(const lock_free_segmented_queue&) = delete;
+  lock_free_segmented_queue& operator=(const lock_free_segmented_queue&) = delete;
+
+  ~lock_free_segmented_queue() {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+    for (auto head = _head.load(std::memory_order_relaxed); head != tail; ++head) {
+      advance_head_segment(head);
+      element(_head_segment, head).~T();
+    }
+
+    for (auto s = _head_segment; s;) {
+      auto next = s->next.load(std::memory_order_relaxed);
+      delete s;
+      s = next;
+    }
+
+    delete _spare.load(std::memory_order_relaxed);
+  }
+
+  void push(T val) {
+    const auto tail = _tail.load(std::memory_order_relaxed);
+    emplace(tail, std::move(val));
+    _tail.store(tail + 1, std::memory_order_release);
+    _not_empty.notify_one();
+  }
+
+  // Writes the whole range, publishing it with a single index update.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return;
+
+    auto tail = _tail.load(std::memory_order_relaxed);
+    for (; first != last; ++first, ++tail)
+      emplace(tail, *first);
+
+    _tail.store(tail, std::memory_order_release);
+    _not_empty.notify_one();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&&) {
+    push(std::move(val));
+    return true;
+  }
+
+  bool try_push(T val) {
+    push(std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>&) {
+    push(std::move(val));
+    return true;
+  }
+
+  T pop() {
+    const auto head = _head.load(std::memory_order_relaxed);
+    _not_empty.wait([&] { return has_data(head); });
+    return take(head);
+  }
+
+  template <typename Pred>
+  std::optional<T> pop_unless(Pred&& p) {
+    const auto head = _head.load(std::memory_order_relaxed);
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return std::nullopt;
+
+    return take(head);
+  }
+
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    const auto head = _head.load(std::memory_order_relaxed);
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return 0;
+
+    return take_all(head, out);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    const auto head = _head.load(std::memory_order_relaxed);
+
+    _not_empty.wait_until([&] { return has_data(head) || p(); }, deadline);
+    if (!has_data(head))
+      return 0;
+
+    return take_all(head, out);
+  }
+
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    const auto head = _head.load(std::memory_order_relaxed);
+
+    _not_empty.wait([&] { return has_data(head) || p(); });
+    if (!has_data(head))
+      return 0;
+
+    _tail_cache = _tail.load(std::memory_order_acquire);
+    const auto last = head + std::min(n, _tail_cache - head);
+    for (auto idx = head; idx != last; ++idx, ++out) {
+      advance_head_segment(idx);
+      auto& e = element(_head_segment, idx);
+      *out = std::move(e);
+      e.~T();
+    }
+
+    _head.store(last, std::memory_order_release);
+    return last - head;
+  }
+
+  bool empty() const noexcept { return _head.load(std::memory_order_acquire) == _tail.load(std::memory_order_acquire); }
+
+  void wake() { _not_empty.notify_all(); }
+
+  // Pushes never wait
+  void wake_producers() noexcept {}
+
+ private:
+  static T& element(segment* s, std::size_t idx) noexcept {
+    return *std::launder(reinterpret_cast<T*>(&s->slots[idx & mask]));
+  }
+
+  // Constructs an element at the producer's index, linking a new segment when crossing a boundary
+  template <typename U>
+  void emplace(std::size_t tail, U&& val) {
+    if ((tail & mask) == 0 && tail != 0) {
+      auto next = _spare.exchange(nullptr, std::memory_order_acquire);
+      if (!next)
+        next = new segment;
+      _tail_segment->next.store(next, std::memory_order_release);
+      _tail_segment = next;
+    }
+
+    new (&_tail_segment->slots[tail & mask]) T(std::forward<U>(val));
+  }
+
+  // Only reloads the producer's index when the cached one says the queue is empty
+  bool has_data(std::size_t head) noexcept {
+    if (head != _tail_cache)
+      return true;
+    _tail_cache = _tail.load(std::memory_order_acquire);
+    return head != _tail_cache;
+  }
+
+  // Moves the consumer to the next segment when crossing a boundary, recycling the drained one
+  void advance_head_segment(std::size_t head) noexcept {
+    if ((head & mask) != 0 || head == 0)
+      return;
+
+    auto drained = _head_segment;
+    _head_segment = drained->next.load(std::memory_order_acquire);
+    drained->next.store(nullptr, std::memory_order_relaxed);
+
+    segment* expected = nullptr;
+    if (!_spare.compare_exchange_strong(expected, drained, std::memory_order_release, std::memory_order_relaxed))
+      delete drained;
+  }
+
+  std::size_t take_all(std::size_t head, std::deque<T>& out) {
+    const auto tail = _tail_cache = _tail.load(std::memory_order_acquire);
+    for (auto idx = head; idx != tail; ++idx) {
+      advance_head_segment(idx);
+      auto& e = element(_head_segment, idx);
+      out.push_back(std::move(e));
+      e.~T();
+    }
+
+    _head.store(tail, std::memory_order_release);
+    return tail - head;
+  }
+
+  T take(std::size_t head) {
+    advance_head_segment(head);
+    auto& e = element(_head_segment, head);
+    T r = std::move(e);
+    e.~T();
+    _head.store(head + 1, std::memory_order_release);
+    return r;
+  }
+
+  // Consumer-owned line: read index, current segment, and the last seen write index
+  alignas(cache_line_size) std::atomic<std::size_t> _head = 0;
+  segment* _head_segment;
+  std::size_t _tail_cache = 0;
+
+  // Producer-owned line: write index and current segment
+  alignas(cache_line_size) std::atomic<std::size_t> _tail = 0;
+  segment* _tail_segment;
+
+  // A drained segment, handed from the consumer back to the producer
+  alignas(cache_line_size) std::atomic<segment*> _spare = nullptr;
+
+  Wait _not_empty;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -10,10 +10,14 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
 #include <cstdint>
+#include <deque>
 #include <optional>
 
+#include "blocking_triple_buffer.hpp"
 #include "helpers.hpp"
+#include "wait_strategies.hpp"
 
 namespace tdp::util {
 
@@ -32,25 +36,70 @@ struct buffer_control_block {
   }
 };
 
-template <typename T>
+template <typename T, typename Wait = hybrid_park>
 class lock_free_triple_buffer {
   using control_block_t = std::atomic<buffer_control_block>;
   static_assert(dependent_bool<control_block_t::is_always_lock_free, T>, "This queue should be lock-free.");
 
  public:
+  // A queue with the same semantics, safe for multiple producers and consumers
+  using concurrent_t = blocking_triple_buffer<T, Wait>;
+
   void push(T val) {
+    offer(std::move(val));
+    _wait.notify_one();
+  }
+
+  // Publishes val without waking the consumer, for consumers that poll.
+  // Returns whether the consumer had taken the previous value, or there was none.
+  bool offer(T val) {
     auto old = _control.load();
 
     _buffer[old.write_idx] = std::move(val);
 
     while (!_control.compare_exchange_weak(old, write_value(old)))
       ;
+
+    return !old.available;
   }
 
-  T pop() {
-    while (!_control.load().available)
+  // Only the last element survives, so the range is written to the same buffer and published once.
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    if (first == last)
+      return;
+
+    auto old = _control.load();
+
+    for (; first != last; ++first)
+      _buffer[old.write_idx] = T(*first);
+
+    while (!_control.compare_exchange_weak(old, write_value(old)))
       ;
 
+    _wait.notify_one();
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&&) {
+    push(std::move(val));
+    return true;
+  }
+
+  bool try_push(T val) {
+    push(std::move(val));
+    return true;
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>&) {
+    push(std::move(val));
+    return true;
+  }
+
+  T pop() {
+    _wait.wait([&] { return _control.load().available; });
+
     auto old = _control.load();
     auto next = read_value(old);
 
@@ -62,10 +111,46 @@ class lock_free_triple_buffer {
 
   template <typename Pred>
   std::optional<T> pop_unless(Pred&& p) {
-    while (!_control.load().available)
-      if (p())
-        break;
+    _wait.wait([&] { return p() || _control.load().available; });
+    return take();
+  }
+
+  template <typename Pred>
+  std::size_t drain_into(std::deque<T>& out, Pred&& p) {
+    _wait.wait([&] { return p() || _control.load().available; });
+    return take_into(out);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  std::size_t drain_until(std::deque<T>& out, Pred&& p, const std::chrono::time_point<Clock, Duration>& deadline) {
+    _wait.wait_until([&] { return p() || _control.load().available; }, deadline);
+    return take_into(out);
+  }
+
+  template <typename OutputIt, typename Pred>
+  std::size_t pop_n_unless(OutputIt& out, std::size_t n, Pred&& p) {
+    if (n == 0)
+      return 0;
+
+    auto val = pop_unless(std::forward<Pred>(p));
+    if (!val)
+      return 0;
+
+    *out = std::move(*val);
+    ++out;
+    return 1;
+  }
+
+  bool empty() const noexcept { return !_control.load().available; }
+
+  void wake() { _wait.notify_all(); }
+
+  // Pushes never wait
+  void wake_producers() noexcept {}
 
+ private:
+  // Takes the latest value, if there's one
+  std::optional<T> take() {
     auto old = _control.load();
 
     if (!old.available)
@@ -78,13 +163,17 @@ class lock_free_triple_buffer {
     return std::move(_buffer[next.read_idx]);
   }
 
-  bool empty() const noexcept { return !_control.load().available; }
-
-  void wake() {}
+  std::size_t take_into(std::deque<T>& out) {
+    auto val = take();
+    if (!val)
+      return 0;
+    out.push_back(std::move(*val));
+    return 1;
+  }
 
- private:
   std::array<T, 3> _buffer;  // TODO: similar to the blocking version, should it support non-default construction?
   control_block_t _control{{0, 1, 2, false}};
+  Wait _wait;
 };
 
 }  // namespace tdp::util
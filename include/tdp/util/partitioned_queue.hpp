@@ -0,0 +1,121 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// partitioned_queue.hpp - A set of queues, routing each element to one of them by its key
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_PARTITIONED_QUEUE_HPP
+#define TDP_PARTITIONED_QUEUE_HPP
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+namespace tdp::util {
+
+//---------------------------------------------------------------------------------------------------------------------
+// partitioned_queue<T, Queue, Partitions, Key, Spread, Hash>
+//
+// Holds Partitions queues of type Queue, each read by a single consumer through partition(i).
+// Elements pushed to it go to partition std::hash(key(element)) % Partitions, so equal keys share a partition.
+// With Spread, elements are tuples of arguments, and key is called with them as std::apply would.
+// Without Hash, key returns the partition itself. Indexes past the last partition go to the last one, and so do
+// negative ones, which wrap to the largest indexes when converted to std::size_t.
+//
+// The key function must be set with bind() before any element is pushed.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <typename T, typename Queue, std::size_t Partitions, typename Key, bool Spread = false, bool Hash = true>
+class partitioned_queue {
+  static_assert(Partitions > 0, "A partitioned queue must have at least one partition.");
+
+ public:
+  void bind(const Key& key) { _key.emplace(key); }
+
+  Queue& partition(std::size_t i) noexcept { return _queues[i]; }
+
+  void push(T val) {
+    auto& queue = route(val);
+    queue.push(std::move(val));
+  }
+
+  // Pushes each partition's share of [first, last) in a single operation
+  template <typename InputIt>
+  void push_range(InputIt first, InputIt last) {
+    std::array<std::vector<T>, Partitions> shares;
+    for (; first != last; ++first) {
+      T val(*first);
+      shares[index_of(val)].push_back(std::move(val));
+    }
+
+    for (std::size_t i = 0; i < Partitions; i++)
+      _queues[i].push_range(std::make_move_iterator(shares[i].begin()), std::make_move_iterator(shares[i].end()));
+  }
+
+  template <typename Pred>
+  bool push_unless(T&& val, Pred&& p) {
+    auto& queue = route(val);
+    return queue.push_unless(std::move(val), std::forward<Pred>(p));
+  }
+
+  bool try_push(T val) {
+    auto& queue = route(val);
+    return queue.try_push(std::move(val));
+  }
+
+  template <typename Rep, typename Period>
+  bool push_for(T val, const std::chrono::duration<Rep, Period>& timeout) {
+    auto& queue = route(val);
+    return queue.push_for(std::move(val), timeout);
+  }
+
+  bool empty() const noexcept {
+    for (auto& queue : _queues)
+      if (!queue.empty())
+        return false;
+    return true;
+  }
+
+  void wake() {
+    for (auto& queue : _queues)
+      queue.wake();
+  }
+
+  void wake_producers() {
+    for (auto& queue : _queues)
+      queue.wake_producers();
+  }
+
+ private:
+  std::size_t index_of(const T& val) const {
+    if constexpr (Spread)
+      return index_of_key(std::apply(*_key, val));
+    else
+      return index_of_key(std::invoke(*_key, val));
+  }
+
+  template <typename K>
+  static std::size_t index_of_key(const K& key) {
+    if constexpr (Hash)
+      return std::hash<K>{}(key) % Partitions;
+    else
+      return std::min(static_cast<std::size_t>(key), Partitions - 1);
+  }
+
+  Queue& route(const T& val) { return _queues[index_of(val)]; }
+
+  std::array<Queue, Partitions> _queues;
+  std::optional<Key> _key;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -0,0 +1,188 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// wait_strategies.hpp - How queues wait for data or space: polling, yielding or parking
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_WAIT_STRATEGIES_HPP
+#define TDP_WAIT_STRATEGIES_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+#include "helpers.hpp"
+
+namespace tdp::util {
+
+//---------------------------------------------------------------------------------------------------------------------
+// Wait strategies
+//
+// Every queue waits through a strategy object, which provides two forms of waiting:
+//
+//   wait(ready) / wait_until(ready, deadline)
+//       For lock-free structures. ready() reads the published atomic state.
+//
+//   wait(lock, ready) / wait_until(lock, ready, deadline)
+//       For structures guarded by a mutex. ready() is evaluated with the lock held.
+//
+// After publishing new state, the queue calls notify_one() or notify_all().
+// Strategies that never sleep don't need notifications, so these are no-ops for them.
+//---------------------------------------------------------------------------------------------------------------------
+
+//---------------------------------------------------------------------------------------------------------------------
+// polling_wait<Pause>
+//
+// Polls the condition in a loop, calling Pause() between checks. Never sleeps.
+//---------------------------------------------------------------------------------------------------------------------
+
+template <void (*Pause)() noexcept>
+class polling_wait {
+ public:
+  template <typename Pred>
+  void wait(Pred&& ready) {
+    while (!ready())
+      Pause();
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_until(Pred&& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+    while (!ready()) {
+      if (Clock::now() >= deadline)
+        return ready();
+      Pause();
+    }
+    return true;
+  }
+
+  template <typename Pred>
+  void wait(std::unique_lock<std::mutex>& lock, Pred&& ready) {
+    while (!ready()) {
+      lock.unlock();
+      Pause();
+      lock.lock();
+    }
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_until(std::unique_lock<std::mutex>& lock, Pred&& ready,
+      const std::chrono::time_point<Clock, Duration>& deadline) {
+    while (!ready()) {
+      if (Clock::now() >= deadline)
+        return ready();
+      lock.unlock();
+      Pause();
+      lock.lock();
+    }
+    return true;
+  }
+
+  void notify_one() noexcept {}
+  void notify_all() noexcept {}
+};
+
+/// Spins on the CPU. Lowest latency, but every waiting stage keeps a core busy.
+using busy_poll_wait = polling_wait<cpu_relax>;
+
+/// Yields to the OS scheduler between checks. Other threads can run, but the waiting thread is never idle.
+using yield_wait = polling_wait<thread_yield>;
+
+//---------------------------------------------------------------------------------------------------------------------
+// hybrid_park
+//
+// On lock-free structures, the waiter spins for a bounded number of iterations, then sleeps on a condition variable.
+// On mutex-guarded structures, the waiter sleeps on the condition variable right away.
+//
+// The notifier only takes the mutex when a waiter is sleeping, so the common case costs a fence and a load.
+// For that to work, the predicate must read the state the notifier published before calling notify_*().
+//
+// On lock-free structures, this is the C++17 equivalent of C++20's std::atomic::wait().
+//---------------------------------------------------------------------------------------------------------------------
+
+class hybrid_park {
+ public:
+  static constexpr int spin_limit = 128;
+
+  template <typename Pred>
+  void wait(Pred&& ready) {
+    if (spin(ready))
+      return;
+
+    std::unique_lock lock{_mutex};
+    _waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    _condition.wait(lock, ready);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_until(Pred&& ready, const std::chrono::time_point<Clock, Duration>& deadline) {
+    if (spin(ready))
+      return true;
+
+    std::unique_lock lock{_mutex};
+    _waiters.fetch_add(1);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const bool r = _condition.wait_until(lock, deadline, ready);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+    return r;
+  }
+
+  template <typename Pred>
+  void wait(std::unique_lock<std::mutex>& lock, Pred&& ready) {
+    // The caller's lock orders this with the notifier, which only changes the state while holding it.
+    _waiters.fetch_add(1, std::memory_order_relaxed);
+    _condition.wait(lock, ready);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  template <typename Pred, typename Clock, typename Duration>
+  bool wait_until(std::unique_lock<std::mutex>& lock, Pred&& ready,
+      const std::chrono::time_point<Clock, Duration>& deadline) {
+    _waiters.fetch_add(1, std::memory_order_relaxed);
+    const bool r = _condition.wait_until(lock, deadline, ready);
+    _waiters.fetch_sub(1, std::memory_order_relaxed);
+    return r;
+  }
+
+  void notify_one() {
+    if (has_waiters()) {
+      { std::unique_lock lock{_mutex}; }
+      _condition.notify_one();
+    }
+  }
+
+  void notify_all() {
+    if (has_waiters()) {
+      { std::unique_lock lock{_mutex}; }
+      _condition.notify_all();
+    }
+  }
+
+ private:
+  template <typename Pred>
+  static bool spin(Pred& ready) {
+    for (int i = 0; i < spin_limit; i++) {
+      if (ready())
+        return true;
+      cpu_relax();
+    }
+    return false;
+  }
+
+  bool has_waiters() const noexcept {
+    // Pairs with the fence in wait(): either the waiter sees the new state, or we see the waiter.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return _waiters.load(std::memory_order_relaxed) != 0;
+  }
+
+  std::atomic<int> _waiters = 0;
+  std::mutex _mutex;
+  std::condition_variable _condition;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -0,0 +1,138 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// work_stealing_pool.hpp - A fixed-size thread pool, with a task queue per thread and work stealing
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef TDP_WORK_STEALING_POOL_HPP
+#define TDP_WORK_STEALING_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "helpers.hpp"
+#include "wait_strategies.hpp"
+
+namespace tdp::util {
+
+//---------------------------------------------------------------------------------------------------------------------
+// pool_task
+//
+// A unit of work run by a pool. The pool doesn't own its tasks: they must outlive their last run.
+//---------------------------------------------------------------------------------------------------------------------
+
+class pool_task {
+ public:
+  virtual void run() noexcept = 0;
+
+ protected:
+  ~pool_task() = default;
+};
+
+//---------------------------------------------------------------------------------------------------------------------
+// work_stealing_pool
+//
+// Runs submitted tasks on a fixed number of threads.
+//
+// Each thread has its own FIFO queue of tasks. A task submitted from a pool thread goes to that thread's queue,
+// and tasks submitted from other threads are spread among the queues in turn.
+// A thread with an empty queue steals the oldest task of another one, and sleeps when there's none to steal.
+//
+// Tasks still queued when the pool is destroyed are dropped.
+//---------------------------------------------------------------------------------------------------------------------
+
+class work_stealing_pool {
+ public:
+  explicit work_stealing_pool(std::size_t threads) : _queues{std::make_unique<task_queue[]>(threads)}, _size{threads} {
+    _threads.reserve(threads);
+    try {
+      for (std::size_t i = 0; i < threads; i++)
+        _threads.emplace_back([this, i] { work(i); });
+    } catch (...) {
+      stop();
+      throw;
+    }
+  }
+
+  work_stealing_pool(const work_stealing_pool&) = delete;
+  work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+  ~work_stealing_pool() { stop(); }
+
+  void submit(pool_task& task) {
+    const auto i = (_current == this) ? _current_index : _next.fetch_add(1, std::memory_order_relaxed) % _size;
+    {
+      std::unique_lock lock{_queues[i]._mutex};
+      _queues[i]._tasks.push_back(&task);
+    }
+    _queued.fetch_add(1);
+    _wait.notify_one();
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept { return _size; }
+
+ private:
+  struct alignas(cache_line_size) task_queue {
+    std::mutex _mutex;
+    std::deque<pool_task*> _tasks;
+  };
+
+  void work(std::size_t index) {
+    _current = this;
+    _current_index = index;
+
+    while (true) {
+      _wait.wait([&] { return _queued.load() != 0 || _stop.load(); });
+      if (_stop)
+        return;
+
+      if (auto* task = take(index))
+        task->run();
+    }
+  }
+
+  // Takes the oldest task of this thread's queue, or steals one from the next non-empty queue
+  pool_task* take(std::size_t index) {
+    for (std::size_t n = 0; n < _size; n++) {
+      auto& queue = _queues[(index + n) % _size];
+      std::unique_lock lock{queue._mutex};
+      if (!queue._tasks.empty()) {
+        auto* task = queue._tasks.front();
+        queue._tasks.pop_front();
+        _queued.fetch_sub(1, std::memory_order_relaxed);
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  void stop() {
+    _stop = true;
+    _wait.notify_all();
+    for (auto& thread : _threads)
+      if (thread.joinable())
+        thread.join();
+  }
+
+  inline static thread_local const work_stealing_pool* _current = nullptr;
+  inline static thread_local std::size_t _current_index = 0;
+
+  std::unique_ptr<task_queue[]> _queues;
+  std::size_t _size;
+  std::vector<std::thread> _threads;
+
+  std::atomic<std::size_t> _queued = 0;
+  std::atomic<std::size_t> _next = 0;
+  std::atomic_bool _stop = false;
+  hybrid_park _wait;
+};
+
+}  // namespace tdp::util
+
+#endif
@@ -5,6 +5,8 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
 
+#include <atomic>
+#include <thread>
 #include <vector>
 
 #include "doctest/doctest.h"
@@ -63,4 +65,77 @@ TEST_CASE("Single-thread Consumers") {
       }
     }
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Broadcast consumers") {
+  constexpr int input_count = 50;
+  std::vector<int> first, second;
+  std::atomic_int first_count = 0, second_count = 0;
+  auto to_first = [&](int v) {
+    first.push_back(v);
+    first_count++;
+  };
+  auto to_second = [&](int v) {
+    second.push_back(v);
+    second_count++;
+  };
+
+  SUBCASE("Every consumer gets every output, in order") {
+    auto pipeline = tdp::input<int> >> [](int x) { return x * 2; } >> tdp::broadcast{to_first, to_second};
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while ((first_count < input_count || second_count < input_count) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(first_count.load(), input_count);
+    REQUIRE_EQ(second_count.load(), input_count);
+
+    for (int i = 0; i < input_count; i++) {
+      REQUIRE_EQ(first[i], i * 2);
+      REQUIRE_EQ(second[i], i * 2);
+    }
+  }
+
+  SUBCASE("Outputs are shared, not copied") {
+    static std::atomic_int copies = 0;
+    struct payload {
+      int value;
+      payload(int v) : value{v} {}
+      payload(const payload& other) : value{other.value} { copies++; }
+      payload(payload&&) = default;
+    };
+
+    auto pipeline = tdp::input<int> >> [](int x) { return payload{x}; }
+                    >> tdp::broadcast{[&](const payload& p) { to_first(p.value); },
+                           [&](const payload& p) { to_second(p.value); }};
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while ((first_count < input_count || second_count < input_count) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(first_count.load(), input_count);
+    REQUIRE_EQ(second_count.load(), input_count);
+    REQUIRE_EQ(copies, 0);
+  }
+
+  SUBCASE("A slow consumer doesn't hold the others back") {
+    auto slow = [&](int v) {
+      std::this_thread::sleep_for(2ms);
+      to_first(v);
+    };
+    auto pipeline = tdp::input<int> >> tdp::via(tdp::policy::spsc_unbounded) >> tdp::broadcast{slow, to_second};
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (second_count < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(second_count.load(), input_count);
+    REQUIRE_LT(first_count, input_count);
+    while (first_count < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(first_count.load(), input_count);
+  }
+}
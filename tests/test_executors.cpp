@@ -0,0 +1,443 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// test_executors.cpp - Test suite for pipelines running on executors
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "doctest/doctest.h"
+#include "tdp/pipeline.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Work-stealing executor") {
+  constexpr int input_count = 1000;
+  constexpr auto increment = [](int x) { return x + 1; };
+
+  // Inputs are given from another thread, as bounded policies can't hold all of them
+  auto check_in_order = [&](auto& pipeline, int offset) {
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i + offset);
+    REQUIRE_FALSE(pipeline.try_get());
+  };
+
+  SUBCASE("Every input is processed, in order") {
+    auto pipeline = tdp::input<int> >> increment >> increment >> tdp::output / tdp::executor::work_stealing(2);
+    check_in_order(pipeline, 2);
+  }
+
+  SUBCASE("Pipelines can have more stages than threads") {
+    auto pipeline = tdp::input<int> >> increment >> increment >> increment >> increment >> increment >> increment
+                    >> tdp::output / tdp::policy::queue / tdp::executor::work_stealing(1);
+    check_in_order(pipeline, 6);
+  }
+
+  SUBCASE("Full bounded stages don't block their thread") {
+    auto pipeline = tdp::input<int> >> increment >> increment >> increment >> increment
+                    >> tdp::output / tdp::policy::spsc_ring<4> / tdp::executor::work_stealing(1);
+    check_in_order(pipeline, 4);
+  }
+
+  SUBCASE("Bounded queues and per-edge policies") {
+    auto pipeline = tdp::input<int> >> increment >> tdp::via(tdp::policy::spsc_unbounded) >> increment
+                    >> tdp::output / tdp::policy::bounded_queue<8> / tdp::executor::work_stealing(2);
+    check_in_order(pipeline, 2);
+  }
+
+  SUBCASE("Smart pointer wrappers") {
+    auto pipeline = tdp::input<int> >> increment
+                    >> tdp::output / tdp::policy::queue / tdp::executor::work_stealing(2) / tdp::as_unique_ptr;
+    check_in_order(*pipeline, 1);
+  }
+
+  SUBCASE("A thread count of 0 uses every hardware thread") {
+    auto pipeline = tdp::input<int> >> increment >> tdp::output / tdp::executor::work_stealing(0);
+    check_in_order(pipeline, 1);
+  }
+
+  SUBCASE("Idle pipelines can be destroyed") {
+    auto pipeline = tdp::input<int> >> increment >> increment >> tdp::output / tdp::executor::work_stealing(2);
+    std::this_thread::sleep_for(10ms);
+  }
+
+  SUBCASE("Busy pipelines can be destroyed") {
+    auto slow = [](int x) {
+      std::this_thread::sleep_for(10us);
+      return x;
+    };
+    auto pipeline = tdp::input<int> >> slow >> increment
+                    >> tdp::output / tdp::policy::spsc_ring<2> / tdp::executor::work_stealing(2);
+    // Stages are left waiting for space in the full queues
+    for (int i = 0; i < input_count; i++)
+      (void)pipeline.try_input(i);
+  }
+}
+
+TEST_CASE("Work-stealing executor with producers and consumers") {
+  SUBCASE("Producers can be paused and resumed") {
+    std::atomic_int produced = 0;
+    auto pipeline = tdp::producer{[&] { return produced++; }}
+                    >> tdp::output / tdp::policy::spsc_ring<16> / tdp::executor::work_stealing(2);
+
+    REQUIRE(pipeline.producing());
+    std::vector<int> outputs = pipeline.wait_get_n(100);
+    for (int i = 0; i < 100; i++)
+      REQUIRE_EQ(outputs[i], i);
+
+    pipeline.pause();
+    REQUIRE_FALSE(pipeline.producing());
+    std::this_thread::sleep_for(10ms);
+    int old_produced = produced;
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_EQ(old_produced, produced);
+
+    pipeline.resume();
+    REQUIRE(pipeline.producing());
+    REQUIRE_EQ(pipeline.wait_get_n(100).size(), 100);
+    REQUIRE_NE(old_produced, produced);
+  }
+
+  SUBCASE("Routes send each input to its branch") {
+    constexpr int input_count = 1000;
+    auto pipeline = tdp::input<int> >> tdp::route{[](int x) { return x % 2; }, [](int x) { return x; },
+                                           [](int x) { return -x; }}
+                    >> tdp::output / tdp::executor::work_stealing(2);
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+    auto outputs = pipeline.wait_get_n(input_count);
+    std::sort(outputs.begin(), outputs.end(), [](int a, int b) { return std::abs(a) < std::abs(b); });
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], (i % 2) ? -i : i);
+  }
+
+  SUBCASE("Taps observe outputs on a task of their own") {
+    constexpr int input_count = 1000;
+    std::atomic_int last = -1;
+    auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::tap{[&](int x) { last = x; }}
+                    >> tdp::output / tdp::executor::work_stealing(2);
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (last != input_count - 1 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(last.load(), input_count - 1);
+  }
+
+  SUBCASE("Broadcast consumers receive every input, in order") {
+    constexpr int input_count = 1000;
+    std::vector<int> first, second;
+    std::atomic_int count = 0;
+    auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::broadcast{[&](int x) {
+                                                                    first.push_back(x);
+                                                                    count++;
+                                                                  },
+                                                                    [&](int x) {
+                                                                      second.push_back(x);
+                                                                      count++;
+                                                                    }} / tdp::executor::work_stealing(2);
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (count < 2 * input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(count.load(), 2 * input_count);
+
+    for (int i = 0; i < input_count; i++) {
+      REQUIRE_EQ(first[i], i);
+      REQUIRE_EQ(second[i], i);
+    }
+  }
+
+  SUBCASE("Merged producers feed the same stages") {
+    auto evens = [i = 0]() mutable { return i += 2; };
+    auto odds = [i = 1]() mutable { return i += 2; };
+    auto pipeline = tdp::producers{evens, odds} >> [](int x) { return x; }
+                    >> tdp::output / tdp::policy::spsc_ring<16> / tdp::executor::work_stealing(2);
+
+    std::vector<int> last = {0, 1};
+    for (int x : pipeline.wait_get_n(1000)) {
+      REQUIRE_EQ(last[x % 2] + 2, x);
+      last[x % 2] = x;
+    }
+  }
+
+  SUBCASE("Consumers receive every input, in order") {
+    constexpr int input_count = 1000;
+    std::vector<int> consumed;
+    std::atomic_int count = 0;
+    auto pipeline = tdp::input<int> >> [](int x) { return x * 2; } >> tdp::consumer{[&](int x) {
+                      consumed.push_back(x);
+                      count++;
+                    }} / tdp::executor::work_stealing(2);
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (count < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(count.load(), input_count);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(consumed[i], i * 2);
+  }
+}
+
+TEST_CASE("Work-stealing executor with stage wrappers") {
+  constexpr int input_count = 1000;
+  auto uneven = [](int x) {
+    if (x % 7 == 0)
+      std::this_thread::sleep_for(10us);
+    return x;
+  };
+
+  SUBCASE("Parallel stages") {
+    auto pipeline = tdp::input<int> >> tdp::parallel<3>(uneven) >> tdp::output / tdp::executor::work_stealing(2);
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    std::sort(outputs.begin(), outputs.end());
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i);
+  }
+
+  SUBCASE("Ordered parallel stages") {
+    auto pipeline = tdp::input<int> >> tdp::ordered_parallel<3>(uneven)
+                    >> tdp::output / tdp::policy::spsc_ring<8> / tdp::executor::work_stealing(2);
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i);
+  }
+
+  SUBCASE("Partitioned stages") {
+    auto key_of = [](int x) { return x % 5; };
+    auto pipeline = tdp::input<int> >> tdp::partition<3>(key_of, uneven)
+                    >> tdp::output / tdp::policy::bounded_queue<8> / tdp::executor::work_stealing(2);
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    std::vector<int> last(5, -1);
+    for (int x : outputs) {
+      REQUIRE_LT(last[key_of(x)], x);
+      last[key_of(x)] = x;
+    }
+  }
+}
+
+TEST_CASE("Work-stealing executor with filters") {
+  constexpr int input_count = 1000;
+  auto is_even = [](int x) { return x % 2 == 0; };
+
+  auto pipeline = tdp::input<int> >> tdp::filter{is_even} >> [](int x) { return x / 2; }
+                  >> tdp::output / tdp::policy::spsc_ring<2> / tdp::executor::work_stealing(1);
+  std::thread feeder{[&] {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+  }};
+
+  std::vector<int> outputs = pipeline.wait_get_n(input_count / 2);
+  feeder.join();
+  for (int i = 0; i < input_count / 2; i++)
+    REQUIRE_EQ(outputs[i], i);
+  REQUIRE_FALSE(pipeline.try_get());
+}
+
+TEST_CASE("Work-stealing executor with flat-map stages") {
+  constexpr int input_count = 100;
+  auto repeat = [](int x) { return std::vector<int>(10, x); };
+
+  // A range larger than the output queue is left half-sent, and the rest is sent by later steps
+  auto pipeline = tdp::input<int> >> tdp::flat_map{repeat} >> [](int x) { return x; }
+                  >> tdp::output / tdp::policy::spsc_ring<2> / tdp::executor::work_stealing(1);
+  std::thread feeder{[&] {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+  }};
+
+  std::vector<int> outputs = pipeline.wait_get_n(10 * input_count);
+  feeder.join();
+  for (int i = 0; i < 10 * input_count; i++)
+    REQUIRE_EQ(outputs[i], i / 10);
+  REQUIRE_FALSE(pipeline.try_get());
+}
+
+TEST_CASE("Work-stealing executor with batch stages") {
+  constexpr int input_count = 1000;
+
+  // Stages never wait on the executor, so batches are cut whenever the stage runs out of input
+  auto pipeline = tdp::input<int> >> tdp::batch<16>(1h) >> tdp::unbatch
+                  >> tdp::output / tdp::policy::spsc_ring<4> / tdp::executor::work_stealing(2);
+  std::thread feeder{[&] {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+  }};
+
+  std::vector<int> outputs = pipeline.wait_get_n(input_count);
+  feeder.join();
+  for (int i = 0; i < input_count; i++)
+    REQUIRE_EQ(outputs[i], i);
+  REQUIRE_FALSE(pipeline.try_get());
+}
+
+TEST_CASE("Shared scheduler") {
+  constexpr int input_count = 100;
+  constexpr auto increment = [](int x) { return x + 1; };
+
+  SUBCASE("A thread count of 0 uses every hardware thread") {
+    tdp::scheduler scheduler;
+    REQUIRE_EQ(scheduler.size(), std::max(1u, std::thread::hardware_concurrency()));
+  }
+
+  SUBCASE("Many pipelines run on the same threads") {
+    tdp::scheduler scheduler{2};
+    auto make_pipeline = [&] {
+      return tdp::input<int> >> increment >> increment
+             >> tdp::output / tdp::executor::on(scheduler) / tdp::as_unique_ptr;
+    };
+
+    std::vector<decltype(make_pipeline())> pipelines;
+    for (int p = 0; p < 50; p++)
+      pipelines.push_back(make_pipeline());
+
+    for (int i = 0; i < input_count; i++)
+      for (auto& pipeline : pipelines)
+        pipeline->input(i);
+
+    for (auto& pipeline : pipelines) {
+      std::vector<int> outputs = pipeline->wait_get_n(input_count);
+      for (int i = 0; i < input_count; i++)
+        REQUIRE_EQ(outputs[i], i + 2);
+    }
+  }
+
+  SUBCASE("Busy pipelines don't starve the others") {
+    tdp::scheduler scheduler{1};
+    std::atomic_int produced = 0;
+    auto busy = tdp::producer{[&] { return produced++; }} >> tdp::consumer{[](int) {}}
+                / tdp::executor::on(scheduler);
+    auto other = tdp::input<int> >> increment >> tdp::output / tdp::executor::on(scheduler);
+
+    for (int i = 0; i < input_count; i++)
+      other.input(i);
+    std::vector<int> outputs = other.wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i + 1);
+    REQUIRE_NE(produced, 0);
+  }
+
+  SUBCASE("Pipelines can be destroyed while the others run") {
+    tdp::scheduler scheduler{2};
+    auto kept = tdp::input<int> >> increment >> tdp::output / tdp::executor::on(scheduler);
+
+    for (int p = 0; p < 20; p++) {
+      auto pipeline = tdp::producer{[i = 0]() mutable { return i++; }} >> increment
+                      >> tdp::output / tdp::policy::spsc_ring<4> / tdp::executor::on(scheduler);
+      kept.input(p);
+    }
+
+    std::vector<int> outputs = kept.wait_get_n(20);
+    for (int i = 0; i < 20; i++)
+      REQUIRE_EQ(outputs[i], i + 1);
+  }
+}
+
+TEST_CASE("Work-stealing executor with forks") {
+  constexpr int input_count = 1000;
+  auto square = [](int x) { return x * x; };
+  auto slow_negate = [](int x) {
+    if (x % 7 == 0)
+      std::this_thread::sleep_for(10us);
+    return -x;
+  };
+
+  // A stage before the fork pushes to its queues from a task, which can leave an input half-sent
+  auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::fork{square, slow_negate}
+                  >> tdp::output / tdp::policy::spsc_ring<2> / tdp::executor::work_stealing(1);
+  std::thread feeder{[&] {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+  }};
+
+  auto outputs = pipeline.wait_get_n(input_count);
+  feeder.join();
+  for (int i = 0; i < input_count; i++) {
+    REQUIRE_EQ(std::get<0>(outputs[i]), i * i);
+    REQUIRE_EQ(std::get<1>(outputs[i]), -i);
+  }
+}
+
+TEST_CASE("Work-stealing executor with linked pipelines") {
+  constexpr int input_count = 500;
+  constexpr auto increment = [](int x) { return x + 1; };
+  auto slow = [](int x) {
+    if (x % 7 == 0)
+      std::this_thread::sleep_for(10us);
+    return x;
+  };
+
+  auto check = [&](auto& source, auto& target) {
+    for (int i = 0; i < input_count; i++)
+      source.input(i);
+
+    std::vector<int> outputs = target->wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i + 1);
+  };
+
+  SUBCASE("Tasks blocked on the input of a target running tasks are scheduled by it") {
+    auto target = tdp::input<int> >> slow
+                  >> tdp::output / tdp::policy::bounded_queue<2> / tdp::executor::work_stealing(1) / tdp::as_shared_ptr;
+    auto source = tdp::input<int> >> increment >> tdp::into(target) / tdp::executor::work_stealing(1);
+    check(source, target);
+  }
+
+  SUBCASE("Linked pipelines can share a single thread") {
+    tdp::scheduler scheduler{1};
+    auto target = tdp::input<int> >> slow
+                  >> tdp::output / tdp::policy::bounded_queue<2> / tdp::executor::on(scheduler) / tdp::as_shared_ptr;
+    auto source = tdp::input<int> >> increment >> tdp::into(target) / tdp::executor::on(scheduler);
+    check(source, target);
+  }
+
+  SUBCASE("Tasks linked to a target running threads wait for room in its input") {
+    auto target = tdp::input<int> >> slow >> tdp::output / tdp::policy::bounded_queue<2> / tdp::as_shared_ptr;
+    auto source = tdp::input<int> >> increment >> tdp::into(target) / tdp::executor::work_stealing(1);
+    check(source, target);
+  }
+}
@@ -5,6 +5,17 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 #include "doctest/doctest.h"
 #include "tdp/pipeline.hpp"
 
@@ -39,4 +50,206 @@ TEST_CASE("Basic Input and Output") {
     auto res = pipeline.try_get();
     REQUIRE(!res.has_value());
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Range Input") {
+  constexpr auto square = [](auto x) { return x * x; };
+
+  SUBCASE("Iterator pairs provide every element, in order") {
+    auto pipeline = tdp::input<int> >> square >> tdp::output;
+
+    std::vector<int> values(100);
+    std::iota(values.begin(), values.end(), 0);
+    pipeline.input_range(values.begin(), values.end());
+
+    for (int v : values)
+      REQUIRE_EQ(pipeline.wait_get(), square(v));
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+
+  SUBCASE("Initializer lists provide multiple arguments as tuples") {
+    auto pipeline = tdp::input<int, int> >> std::plus<>{} >> tdp::output;
+
+    pipeline.input_range({{1, 2}, {3, 4}, {5, 6}});
+
+    REQUIRE_EQ(pipeline.wait_get(), 3);
+    REQUIRE_EQ(pipeline.wait_get(), 7);
+    REQUIRE_EQ(pipeline.wait_get(), 11);
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+
+  SUBCASE("Empty ranges provide nothing") {
+    auto pipeline = tdp::input<int> >> square >> tdp::output;
+
+    std::vector<int> values;
+    pipeline.input_range(values.begin(), values.end());
+
+    REQUIRE(pipeline.input_is_empty());
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+}
+
+TEST_CASE("Bulk Output") {
+  constexpr auto square = [](auto x) { return x * x; };
+  auto pipeline = tdp::input<int> >> square >> tdp::output;
+
+  std::vector<int> values(100);
+  std::iota(values.begin(), values.end(), 0);
+
+  std::vector<int> expected;
+  std::transform(values.begin(), values.end(), std::back_inserter(expected), square);
+
+  SUBCASE("wait_get_n() waits for the requested amount of outputs, in order") {
+    pipeline.input_range(values.begin(), values.end());
+
+    auto first = pipeline.wait_get_n(60);
+    auto second = pipeline.wait_get_n(40);
+    first.insert(first.end(), second.begin(), second.end());
+
+    REQUIRE_EQ(first, expected);
+    REQUIRE(pipeline.wait_get_n(0).empty());
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+
+  SUBCASE("try_get_up_to() never retrieves more than requested") {
+    std::vector<int> outputs;
+    REQUIRE_EQ(pipeline.try_get_up_to(10, std::back_inserter(outputs)), 0);
+
+    pipeline.input_range(values.begin(), values.end());
+    while (outputs.size() < expected.size()) {
+      const auto previous = outputs.size();
+      const auto n = pipeline.try_get_up_to(7, std::back_inserter(outputs));
+      REQUIRE_LE(n, 7);
+      REQUIRE_EQ(outputs.size(), previous + n);
+    }
+
+    REQUIRE_EQ(outputs, expected);
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+
+  SUBCASE("drain_to() retrieves every available output") {
+    pipeline.input_range(values.begin(), values.end());
+
+    std::vector<int> outputs(expected.size());
+    auto end = outputs.begin();
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (end != outputs.end() && std::chrono::steady_clock::now() < deadline)
+      end = pipeline.drain_to(end);
+
+    REQUIRE_EQ(outputs, expected);
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+}
+
+TEST_CASE("Linked pipelines") {
+  constexpr auto square = [](int x) { return x * x; };
+  constexpr auto half = [](int x) { return x / 2; };
+  auto target = tdp::input<int> >> square >> tdp::output / tdp::as_shared_ptr;
+
+  SUBCASE("The outputs go to the input of the linked pipeline, in order") {
+    auto source = tdp::input<int> >> half >> tdp::into(target);
+
+    for (int i = 0; i < 100; i++)
+      source.input(2 * i);
+    for (int i = 0; i < 100; i++)
+      REQUIRE_EQ(target->wait_get(), square(i));
+  }
+
+  SUBCASE("Tuples are the arguments of the linked pipeline") {
+    auto sum = tdp::input<int, int> >> std::plus<>{} >> tdp::output / tdp::as_shared_ptr;
+    auto source = tdp::input<int> >> [](int x) { return std::tuple{x, x + 1}; } >> tdp::into(sum);
+
+    source.input(3);
+    REQUIRE_EQ(sum->wait_get(), 7);
+  }
+
+  SUBCASE("Producers and taps can be linked") {
+    std::atomic_int observed = 0;
+    auto producer = tdp::producer{[i = 0]() mutable { return i++; }}
+                    >> tdp::tap{[&](int) { observed++; }} >> tdp::into(target);
+
+    for (int i = 0; i < 100; i++)
+      REQUIRE_EQ(target->wait_get(), square(i));
+    producer.pause();
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (observed == 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_LT(0, observed.load());
+  }
+
+  SUBCASE("Many pipelines can be linked to the same one, which they keep alive") {
+    std::atomic_int sum = 0;
+    auto shared = tdp::input<int> >> tdp::consumer{[&](int x) { sum += x; }} / tdp::as_shared_ptr;
+    auto a = tdp::input<int> >> half >> tdp::into(shared);
+    auto b = tdp::input<int> >> square >> tdp::into(shared);
+    shared.reset();
+
+    for (int i = 0; i < 10; i++) {
+      a.input(2 * i);
+      b.input(i);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (sum != 45 + 285 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(sum.load(), 45 + 285);
+  }
+
+  SUBCASE("A full input holds back the linked stages") {
+    auto slow = [](int x) {
+      std::this_thread::sleep_for(std::chrono::microseconds(100));
+      return x;
+    };
+    auto bounded = tdp::input<int> >> slow >> tdp::output / tdp::policy::bounded_queue<2> / tdp::as_shared_ptr;
+    auto source = tdp::input<int> >> tdp::parallel<2>(half) >> tdp::into(bounded);
+
+    for (int i = 0; i < 200; i++)
+      source.input(2 * i);
+
+    std::vector<int> outputs;
+    for (int i = 0; i < 200; i++)
+      outputs.push_back(bounded->wait_get());
+    std::sort(outputs.begin(), outputs.end());
+
+    std::vector<int> expected(200);
+    std::iota(expected.begin(), expected.end(), 0);
+    REQUIRE_EQ(outputs, expected);
+  }
+
+  SUBCASE("Destroying a pipeline blocked on a full input") {
+    std::atomic_int called = 0;
+    auto counted_half = [&](int x) {
+      called++;
+      return half(x);
+    };
+    auto stuck = tdp::input<int> >> counted_half >> tdp::output / tdp::policy::bounded_queue<1> / tdp::as_shared_ptr;
+    {
+      auto source = tdp::input<int> >> half >> tdp::into(stuck);
+      for (int i = 0; i < 10; i++)
+        source.input(i);
+
+      // The output and input of the target are full once its second call can't send its output
+      const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+      while (called < 2 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      REQUIRE_LE(2, called.load());
+    }
+    REQUIRE(stuck->wait_get() == 0);
+  }
+
+  SUBCASE("Destroying a linked pipeline leaves its target running") {
+    auto forked = tdp::input<int> >> tdp::fork{square, half}
+                  >> tdp::output / tdp::policy::bounded_queue<4> / tdp::as_shared_ptr;
+    {
+      auto source = tdp::input<int> >> half >> tdp::into(forked);
+      source.input(4);
+      REQUIRE(forked->wait_get() == std::tuple{4, 1});
+    }
+
+    REQUIRE(forked->input_for(std::chrono::milliseconds(100), 6));
+    forked->input(8);
+    REQUIRE(forked->wait_get() == std::tuple{36, 3});
+    REQUIRE(forked->wait_get() == std::tuple{64, 4});
+  }
+}
@@ -7,6 +7,13 @@
 
 #include <math.h>
 
+#include <chrono>
+#include <ctime>
+#include <iterator>
+#include <numeric>
+#include <thread>
+#include <vector>
+
 #include "doctest/doctest.h"
 #include "tdp/pipeline.hpp"
 
@@ -83,4 +90,324 @@ TEST_CASE("Lock-free Triple Buffer policy") {
 
   auto res = pipeline.try_get();
   REQUIRE(!res.has_value());
-}
\ No newline at end of file
+}
+
+TEST_CASE("Lock-free policies park idle stages") {
+  auto twice = [](int x) { return 2 * x; };
+  auto pipeline = tdp::input<int> >> twice >> twice >> tdp::output / tdp::policy::triple_buffer_lockfree;
+
+  // Let all stages run out of spinning iterations and park
+  std::this_thread::sleep_for(50ms);
+
+#ifndef _WIN32  // std::clock() measures wall time on Windows
+  const auto cpu_start = std::clock();
+  std::this_thread::sleep_for(100ms);
+  const auto cpu_ms = 1000.0 * double(std::clock() - cpu_start) / CLOCKS_PER_SEC;
+  REQUIRE_LT(cpu_ms, 50.0);
+#endif
+
+  // Parked stages must still be woken by new input
+  for (int i = 0; i < 10; i++) {
+    pipeline.input(i);
+    REQUIRE_EQ(pipeline.wait_get(), 4 * i);
+    std::this_thread::sleep_for(1ms);
+  }
+}
+
+TEST_CASE("Lock-free SPSC Ring policy") {
+  SUBCASE("Every input is processed, in order") {
+    constexpr int chunk = 1000;
+    auto pipeline = tdp::input<double, double> >> proc >> tdp::output / tdp::policy::spsc_ring<1024>;
+
+    for (int i = 0; i < input_count; i += chunk) {
+      for (int j = i; j < i + chunk; j++)
+        pipeline.input(j, j + 2);
+      for (int j = i; j < i + chunk; j++)
+        REQUIRE_EQ(pipeline.wait_get(), proc(j, j + 2));
+    }
+
+    auto res = pipeline.try_get();
+    REQUIRE(!res.has_value());
+  }
+
+  SUBCASE("Full stages wait for the next one instead of dropping values") {
+    constexpr int capacity = 4;
+    std::atomic_int produced = 0;
+    auto identity = [](int x) { return x; };
+    auto pipeline = tdp::producer{[&] { return produced++; }} >> identity >> tdp::output / tdp::policy::spsc_ring<capacity>;
+
+    // Two full edges, plus the values held by each thread
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_LE(produced, 2 * capacity + 3);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+  }
+}
+
+TEST_CASE("Lock-free SPSC Unbounded policy") {
+  auto twice = [](double x) { return 2 * x; };
+  auto pipeline = tdp::input<double, double> >> proc >> twice >> tdp::output / tdp::policy::spsc_unbounded;
+
+  for (int i = 0; i < input_count; i++) {
+    pipeline.input(i, i + 2);
+  }
+
+  for (int i = 0; i < input_count; i++) {
+    REQUIRE_EQ(pipeline.wait_get(), 2 * proc(i, i + 2));
+  }
+
+  auto res = pipeline.try_get();
+  REQUIRE(!res.has_value());
+}
+
+TEST_CASE("Bounded Queue policy") {
+  constexpr int capacity = 4;
+  auto identity = [](int x) { return x; };
+
+  SUBCASE("Every input is processed, in order") {
+    auto pipeline = tdp::input<int> >> identity >> identity >> tdp::output / tdp::policy::bounded_queue<capacity>;
+
+    for (int i = 0; i < input_count; i += capacity) {
+      for (int j = i; j < i + capacity; j++)
+        pipeline.input(j);
+      for (int j = i; j < i + capacity; j++)
+        REQUIRE_EQ(pipeline.wait_get(), j);
+    }
+
+    REQUIRE_FALSE(pipeline.try_get().has_value());
+  }
+
+  SUBCASE("Full stages reject input on try_input() and input_for()") {
+    auto pipeline = tdp::input<int> >> identity >> tdp::output / tdp::policy::bounded_queue<capacity>;
+
+    // The output queue, the stage and the input queue can hold at most 2 * capacity + 1 values
+    int accepted = 0;
+    for (int i = 0; i < 2 * capacity + 1; i++) {
+      pipeline.input(i);
+      accepted++;
+    }
+
+    std::this_thread::sleep_for(10ms);
+    while (pipeline.try_input(accepted))
+      accepted++;
+
+    REQUIRE_LE(accepted, 2 * capacity + 2);
+    REQUIRE_FALSE(pipeline.input_for(1ms, accepted));
+
+    for (int i = 0; i < accepted; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+
+    REQUIRE(pipeline.try_input(accepted));
+    REQUIRE(pipeline.input_for(10ms, accepted + 1));
+    REQUIRE_EQ(pipeline.wait_get(), accepted);
+    REQUIRE_EQ(pipeline.wait_get(), accepted + 1);
+  }
+
+  SUBCASE("Producers slow down to the consumer's rate") {
+    std::atomic_int produced = 0;
+    auto pipeline = tdp::producer{[&] { return produced++; }} >> identity >> tdp::output / tdp::policy::bounded_queue<capacity>;
+
+    // Two full edges, plus the values held by each thread
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_LE(produced, 2 * capacity + 3);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+  }
+}
+
+template <const auto& policy>
+void lock_step() {
+  auto twice = [](int x) { return 2 * x; };
+  auto pipeline = tdp::input<int> >> twice >> twice >> tdp::output / policy;
+
+  for (int i = 0; i < 100; i++) {
+    pipeline.input(i);
+    REQUIRE_EQ(pipeline.wait_get(), 4 * i);
+  }
+}
+
+template <typename Wait>
+void lock_step_all_policies() {
+  lock_step<tdp::policy::queue.with<Wait>>();
+  lock_step<tdp::policy::bounded_queue<4>.template with<Wait>>();
+  lock_step<tdp::policy::triple_buffer.with<Wait>>();
+  lock_step<tdp::policy::triple_buffer_lockfree.with<Wait>>();
+  lock_step<tdp::policy::spsc_ring<4>.template with<Wait>>();
+  lock_step<tdp::policy::spsc_unbounded.with<Wait>>();
+}
+
+TEST_CASE("Wait strategies") {
+  SUBCASE("Park") {
+    lock_step_all_policies<tdp::wait::park>();
+  }
+
+  SUBCASE("Yield") {
+    lock_step_all_policies<tdp::wait::yield>();
+  }
+
+  SUBCASE("Busy poll") {
+    lock_step_all_policies<tdp::wait::busy_poll>();
+  }
+}
+
+template <const auto& policy>
+void range_input_is_lossless() {
+  constexpr int count = 10'000;
+  std::atomic_int consumed = 0;
+  auto pipeline = tdp::input<int> >> [](int x) { return x + 1; } >> tdp::consumer{[&](int x) {
+    if (x == consumed + 1)
+      consumed++;
+  }} / policy;
+
+  std::vector<int> values(count);
+  std::iota(values.begin(), values.end(), 0);
+  pipeline.input_range(values.begin(), values.end());
+
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (consumed != count && std::chrono::steady_clock::now() < deadline)
+    std::this_thread::yield();
+  REQUIRE_EQ(consumed.load(), count);
+}
+
+TEST_CASE("Range input on lossless policies") {
+  range_input_is_lossless<tdp::policy::queue>();
+  range_input_is_lossless<tdp::policy::bounded_queue<4>>();
+  range_input_is_lossless<tdp::policy::spsc_ring<4>>();
+  range_input_is_lossless<tdp::policy::spsc_unbounded>();
+}
+
+TEST_CASE("Range input on triple buffers keeps the last element") {
+  auto check = [](auto&& pipeline) {
+    std::vector<int> values(100);
+    std::iota(values.begin(), values.end(), 0);
+    pipeline.input_range(values.begin(), values.end());
+    REQUIRE_EQ(pipeline.wait_get(), 99);
+  };
+
+  check(tdp::input<int> >> [](int x) { return x; } >> tdp::output / tdp::policy::triple_buffer);
+  check(tdp::input<int> >> [](int x) { return x; } >> tdp::output / tdp::policy::triple_buffer_lockfree);
+}
+
+template <const auto& policy>
+void bulk_output_is_lossless() {
+  constexpr int count = 1'000;
+  auto pipeline = tdp::input<int> >> [](int x) { return x + 1; } >> tdp::output / policy;
+
+  std::vector<int> values(count);
+  std::iota(values.begin(), values.end(), 0);
+  std::thread feeder{[&] { pipeline.input_range(values.begin(), values.end()); }};
+
+  auto outputs = pipeline.wait_get_n(count / 2);
+  outputs.resize(count);
+  auto end = outputs.begin() + count / 2;
+
+  const auto deadline = std::chrono::steady_clock::now() + 5s;
+  while (end != outputs.end() && std::chrono::steady_clock::now() < deadline)
+    end = pipeline.drain_to(end);
+  feeder.join();
+  REQUIRE(end == outputs.end());
+
+  for (int i = 0; i < count; i++)
+    REQUIRE_EQ(outputs[i], i + 1);
+}
+
+TEST_CASE("Bulk output on lossless policies") {
+  bulk_output_is_lossless<tdp::policy::queue>();
+  bulk_output_is_lossless<tdp::policy::bounded_queue<4>>();
+  bulk_output_is_lossless<tdp::policy::spsc_ring<4>>();
+  bulk_output_is_lossless<tdp::policy::spsc_unbounded>();
+}
+
+TEST_CASE("Per-edge policies") {
+  constexpr int capacity = 4;
+  auto identity = [](int x) { return x; };
+
+  SUBCASE("Each edge keeps its own policy") {
+    auto pipeline = tdp::input<int> >> tdp::via(tdp::policy::spsc_ring<capacity>) >> identity  //
+                    >> tdp::via(tdp::policy::triple_buffer_lockfree) >> identity               //
+                    >> tdp::via(tdp::policy::bounded_queue<capacity>) >> identity >> tdp::output;
+
+    for (int i = 0; i < input_count; i++) {
+      pipeline.input(i);
+      REQUIRE_EQ(pipeline.wait_get(), i);
+    }
+  }
+
+  SUBCASE("A policy after the input applies to the input") {
+    std::atomic_bool blocked = true;
+    auto wait = [&](int x) {
+      const auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (blocked && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      return x;
+    };
+
+    auto pipeline = tdp::input<int> >> tdp::via(tdp::policy::bounded_queue<1>) >> wait >> tdp::output;
+
+    int accepted = 0;
+    while (pipeline.try_input(accepted))
+      accepted++;
+
+    // At most one value in the input queue, and one taken by the stage
+    REQUIRE_LE(accepted, 2);
+    blocked = false;
+
+    for (int i = 0; i < accepted; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+  }
+
+  SUBCASE("Producers and consumers accept per-edge policies") {
+    std::atomic_int consumed = 0;
+    int produced = 0;
+
+    auto pipeline = tdp::producer{[&] { return produced++; }} >> tdp::via(tdp::policy::spsc_ring<capacity>)
+                    >> identity >> tdp::via(tdp::policy::spsc_unbounded) >> tdp::consumer{[&](int x) {
+                        if (x == consumed)
+                          consumed++;
+                      }};
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (consumed < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_LE(input_count, consumed.load());
+  }
+}
+
+TEST_CASE("Every pipeline shape honors its policy") {
+  auto identity = [](int x) { return x; };
+  auto produce = [] { return 1; };
+  auto consume = [](int) {};
+
+  SUBCASE("Default policy") {
+    auto pipeline = tdp::producer{produce} >> tdp::output;
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::queue>);
+    static_assert(!tdp::uses_policy_v<decltype(pipeline), tdp::policy::triple_buffer_lockfree>);
+    REQUIRE_EQ(pipeline.wait_get(), 1);
+  }
+
+  SUBCASE("Producer to output") {
+    auto pipeline = tdp::producer{produce} >> tdp::output / tdp::policy::triple_buffer_lockfree;
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::triple_buffer_lockfree>);
+    REQUIRE_EQ(pipeline.wait_get(), 1);
+  }
+
+  SUBCASE("Producer to consumer") {
+    auto pipeline = tdp::producer{produce} >> tdp::consumer{consume} / tdp::policy::spsc_ring<4>;
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::spsc_ring<4>>);
+  }
+
+  SUBCASE("Input to consumer") {
+    auto pipeline = tdp::input<int> >> tdp::consumer{consume} / tdp::policy::bounded_queue<4>;
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::bounded_queue<4>>);
+    pipeline.input(1);
+  }
+
+  SUBCASE("Smart pointer wrappers") {
+    auto pipeline = tdp::input<int> >> identity >> tdp::output / tdp::policy::triple_buffer / tdp::as_shared_ptr;
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::triple_buffer>);
+    pipeline->input(1);
+    REQUIRE_EQ(pipeline->wait_get(), 1);
+  }
+}
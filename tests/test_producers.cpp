@@ -5,6 +5,10 @@
 // Distributed under the Boost Software License, Version 1.0.
 // (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
 
+#include <algorithm>
+#include <utility>
+#include <vector>
+
 #include "doctest/doctest.h"
 #include "tdp/pipeline.hpp"
 
@@ -62,4 +66,77 @@ TEST_CASE("Producers") {
 
     REQUIRE_EQ(produced, consumed);
   }
-}
\ No newline at end of file
+}
+
+TEST_CASE("Merged producers") {
+  constexpr int source_count = 3;
+  constexpr int output_count = 3000;
+
+  // Source s produces s, s + 3, s + 6, ...
+  std::atomic_int produced = 0;
+  auto source = [&](int s) {
+    return [&, next = s]() mutable {
+      produced++;
+      return std::exchange(next, next + source_count);
+    };
+  };
+
+  // Outputs of each source must keep their order, and every source must feed the pipeline
+  auto check_merged = [&](auto& pipeline) {
+    std::vector<int> last(source_count, -1);
+    auto all_seen = [&] { return std::count(last.begin(), last.end(), -1) == 0; };
+    for (int n = 0; n < output_count || !all_seen(); n++) {
+      int x = pipeline.wait_get();
+      REQUIRE_LT(last[x % source_count], x);
+      last[x % source_count] = x;
+    }
+  };
+
+  SUBCASE("Every producer feeds the same stages") {
+    auto pipeline = tdp::producers{source(0), source(1), source(2)} >> [](int x) { return x; } >> tdp::output;
+    check_merged(pipeline);
+  }
+
+  SUBCASE("Lock-free policies are replaced by their concurrent form") {
+    auto pipeline = tdp::producers{source(0), source(1), source(2)} >> tdp::output / tdp::policy::spsc_ring<16>;
+    check_merged(pipeline);
+  }
+
+  SUBCASE("pause() and resume() control every producer") {
+    auto pipeline = tdp::producers{source(0), source(1), source(2)} >> tdp::output / tdp::policy::bounded_queue<16>;
+    REQUIRE(pipeline.producing());
+    check_merged(pipeline);
+
+    pipeline.pause();
+    REQUIRE_FALSE(pipeline.producing());
+    std::this_thread::sleep_for(10ms);
+    int old_produced = produced;
+    std::this_thread::sleep_for(10ms);
+    REQUIRE_EQ(old_produced, produced);
+
+    pipeline.resume();
+    REQUIRE(pipeline.producing());
+    REQUIRE_EQ(pipeline.wait_get_n(output_count).size(), output_count);
+    REQUIRE_NE(old_produced, produced);
+  }
+
+  SUBCASE("Producers can feed a consumer directly") {
+    std::atomic_int from_first = 0;
+    std::atomic_int from_second = 0;
+    auto pipeline = tdp::producers{source(0), source(1)} >> tdp::consumer{[&](int x) {
+      if (x % source_count == 0)
+        from_first++;
+      else
+        from_second++;
+    }};
+
+    // Both producers must have fed the consumer
+    auto done = [&] { return from_first > 0 && from_second > 0 && from_first + from_second >= output_count; };
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (!done() && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_LT(0, from_first.load());
+    REQUIRE_LT(0, from_second.load());
+    REQUIRE_LE(output_count, from_first + from_second);
+  }
+}
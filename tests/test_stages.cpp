@@ -0,0 +1,840 @@
+// The Darkest Pipeline - https://github.com/JoelFilho/TDP
+// test_stages.cpp - Test suite for stage wrappers
+
+// Copyright Joel P. C. Filho 2020 - 2020
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE.md or copy at https://www.boost.org/LICENSE_1_0.txt)
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <optional>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "doctest/doctest.h"
+#include "tdp/pipeline.hpp"
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Parallel stages") {
+  constexpr int input_count = 1000;
+  constexpr auto square = [](int x) { return x * x; };
+
+  auto check_all_outputs = [&](auto& pipeline) {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    std::sort(outputs.begin(), outputs.end());
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], square(i));
+    REQUIRE_FALSE(pipeline.try_get());
+  };
+
+  SUBCASE("Every input is processed exactly once") {
+    auto pipeline = tdp::input<int> >> tdp::parallel<4>(square) >> tdp::output;
+    check_all_outputs(pipeline);
+  }
+
+  SUBCASE("Parallel stages can be surrounded by other stages") {
+    auto identity = [](int x) { return x; };
+    auto pipeline = tdp::input<int> >> identity >> tdp::parallel<3>(square) >> identity >> tdp::output;
+    check_all_outputs(pipeline);
+  }
+
+  SUBCASE("Lock-free policies are replaced by their concurrent form") {
+    auto pipeline = tdp::input<int> >> tdp::parallel<4>(square) >> tdp::output / tdp::policy::spsc_unbounded;
+    check_all_outputs(pipeline);
+    static_assert(tdp::uses_policy_v<decltype(pipeline), tdp::policy::spsc_unbounded>);
+  }
+
+  SUBCASE("Replicas run at the same time") {
+    constexpr int replicas = 4;
+    std::atomic_int arrived = 0;
+
+    // Each call waits for all replicas to be running, which can't happen on a single thread
+    auto rendezvous = [&](int) {
+      arrived++;
+      const auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (arrived < replicas && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      return arrived >= replicas;
+    };
+
+    auto pipeline = tdp::input<int> >> tdp::parallel<replicas>(rendezvous) >> tdp::output;
+    for (int i = 0; i < replicas; i++)
+      pipeline.input(i);
+
+    for (int i = 0; i < replicas; i++)
+      REQUIRE(pipeline.wait_get());
+  }
+
+  SUBCASE("Consumers can be parallel") {
+    std::atomic_int consumed = 0;
+    auto pipeline = tdp::input<int> >> tdp::consumer{tdp::parallel<2>([&](int) { consumed++; })};
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (consumed < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(consumed.load(), input_count);
+  }
+}
+
+TEST_CASE("Ordered parallel stages") {
+  constexpr int input_count = 200;
+
+  // Later inputs finish first, so only the reorder buffer can keep them in order
+  auto uneven = [](int x) {
+    std::this_thread::sleep_for(std::chrono::microseconds((input_count - x) % 7 * 100));
+    return x;
+  };
+
+  SUBCASE("Outputs keep the input order") {
+    auto pipeline = tdp::input<int> >> tdp::ordered_parallel<4>(uneven) >> tdp::output;
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    auto outputs = pipeline.wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i);
+  }
+
+  SUBCASE("Ordered stages keep lock-free policies") {
+    auto pipeline = tdp::producer{[i = 0]() mutable { return i++; }} >> tdp::ordered_parallel<3, 3>(uneven)
+                    >> tdp::output / tdp::policy::spsc_ring<4>;
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+  }
+
+  SUBCASE("Ordered stages can feed consumers, which get the outputs in order") {
+    std::atomic_int consumed = 0;
+    auto pipeline = tdp::input<int> >> tdp::ordered_parallel<2>(uneven) >> tdp::consumer{[&](int x) {
+      if (x == consumed)
+        consumed++;
+    }};
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (consumed < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(consumed.load(), input_count);
+  }
+}
+
+TEST_CASE("Partitioned stages") {
+  constexpr int input_count = 1000;
+  constexpr int keys = 10;
+
+  auto key_of = [](int x) { return x % keys; };
+
+  // Each copy of the stage tracks the last value of its keys, and checks they arrive in order.
+  // The thread is recorded too, so each key can be checked to stay on the same replica.
+  auto in_order = [last = std::vector<int>(keys, -1)](int x) mutable {
+    const bool ordered = last[x % keys] < x;
+    last[x % keys] = x;
+    return std::tuple{x, ordered, std::this_thread::get_id()};
+  };
+
+  auto check_all_outputs = [&](auto& pipeline) {
+    std::vector<std::tuple<int, bool, std::thread::id>> outputs = pipeline.wait_get_n(input_count);
+    std::sort(outputs.begin(), outputs.end());
+
+    std::vector<std::optional<std::thread::id>> replica_of_key(keys);
+    for (int i = 0; i < input_count; i++) {
+      auto [x, ordered, replica] = outputs[i];
+      REQUIRE_EQ(x, i);
+      REQUIRE(ordered);
+
+      auto& expected = replica_of_key[x % keys];
+      if (!expected)
+        expected = replica;
+      REQUIRE(*expected == replica);
+    }
+  };
+
+  SUBCASE("Equal keys are processed in order by the same replica") {
+    auto pipeline = tdp::input<int> >> tdp::partition<4>(key_of, in_order) >> tdp::output;
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    check_all_outputs(pipeline);
+  }
+
+  SUBCASE("Partitioned stages can follow other stages, and accept range input") {
+    auto identity = [](int x) { return x; };
+    auto pipeline = tdp::input<int> >> identity >> tdp::partition<3>(key_of, in_order) >> tdp::output;
+
+    std::vector<int> inputs(input_count);
+    std::iota(inputs.begin(), inputs.end(), 0);
+    pipeline.input_range(inputs.begin(), inputs.end());
+
+    check_all_outputs(pipeline);
+  }
+
+  SUBCASE("Partitioned stages keep lock-free policies on their input") {
+    auto pipeline = tdp::producer{[i = 0]() mutable { return i++; }} >> tdp::partition<2>(key_of, in_order)
+                    >> tdp::output / tdp::policy::spsc_ring<16>;
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE(std::get<1>(pipeline.wait_get()));
+  }
+
+  SUBCASE("Partitioned consumers") {
+    std::atomic_int consumed = 0;
+    auto pipeline = tdp::input<int, int> >> tdp::consumer{tdp::partition<2>(
+                        [](int session, int) { return session; }, [&](int, int) { consumed++; })};
+
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i % keys, i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (consumed < input_count && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(consumed.load(), input_count);
+  }
+}
+
+TEST_CASE("Fused stages") {
+  constexpr int input_count = 100;
+  constexpr auto increment = [](int x) { return x + 1; };
+  constexpr auto square = [](int x) { return x * x; };
+
+  SUBCASE("Functions are called in order, each with the previous result") {
+    auto pipeline = tdp::input<int> >> tdp::fuse{increment, square, increment} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], (i + 1) * (i + 1) + 1);
+  }
+
+  SUBCASE("Fused functions run on the same thread") {
+    auto thread_of = [](int x) { return std::make_pair(x, std::this_thread::get_id()); };
+    auto same_thread = [](std::pair<int, std::thread::id> p) { return p.second == std::this_thread::get_id(); };
+    auto pipeline = tdp::input<int> >> tdp::fuse{thread_of, same_thread} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    for (bool same : pipeline.wait_get_n(input_count))
+      REQUIRE(same);
+  }
+
+  SUBCASE("Fused stages can take many arguments, produce and consume") {
+    std::atomic_int sum = 0;
+    auto add = [](int a, int b) { return a + b; };
+    auto pipeline = tdp::input<int, int> >> tdp::consumer{tdp::fuse{add, square, [&](int x) { sum += x; }}};
+    pipeline.input(1, 2);
+    pipeline.input(3, 4);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (sum != 9 + 49 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(sum.load(), 9 + 49);
+
+    auto produced = tdp::producer{tdp::fuse{[i = 0]() mutable { return i++; }, square}} >> tdp::output;
+    std::vector<int> outputs = produced.wait_get_n(10);
+    for (int i = 0; i < 10; i++)
+      REQUIRE_EQ(outputs[i], i * i);
+  }
+
+  SUBCASE("Fused stages can be run by many threads") {
+    auto pipeline = tdp::input<int> >> tdp::ordered_parallel<3>(tdp::fuse{increment, square}) >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], (i + 1) * (i + 1));
+  }
+
+  SUBCASE("Invalid chains are rejected") {
+    auto size = [](const std::vector<int>& v) { return v.size(); };
+    static_assert(std::is_invocable_v<decltype(tdp::fuse{increment, square}), int>);
+    static_assert(!std::is_invocable_v<decltype(tdp::fuse{increment, size}), int>);
+  }
+}
+
+TEST_CASE("Forks") {
+  constexpr int input_count = 1000;
+  constexpr auto square = [](int x) { return x * x; };
+  constexpr auto negate = [](int x) { return -x; };
+
+  auto check_joined = [&](auto& pipeline) {
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    auto outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    for (int i = 0; i < input_count; i++) {
+      REQUIRE_EQ(std::get<0>(outputs[i]), i * i);
+      REQUIRE_EQ(std::get<1>(outputs[i]), -i);
+    }
+  };
+
+  SUBCASE("Each input gives a tuple of branch results, in order") {
+    auto pipeline = tdp::input<int> >> tdp::fork{square, negate} >> tdp::output;
+    check_joined(pipeline);
+  }
+
+  SUBCASE("Branches share the same input") {
+    auto address = [](const std::vector<int>& v) { return v.data(); };
+    auto pipeline = tdp::input<std::vector<int>> >> tdp::fork{address, address, address} >> tdp::output;
+    for (int i = 0; i < 10; i++)
+      pipeline.input(std::vector<int>(100, i));
+
+    for (auto [a, b, c] : pipeline.wait_get_n(10)) {
+      REQUIRE_EQ(a, b);
+      REQUIRE_EQ(b, c);
+    }
+  }
+
+  SUBCASE("Branches run on their own threads") {
+    auto thread_id = [](int) { return std::this_thread::get_id(); };
+    auto pipeline = tdp::input<int> >> tdp::fork{thread_id, thread_id} >> tdp::output;
+    pipeline.input(0);
+
+    auto [a, b] = pipeline.wait_get();
+    REQUIRE_NE(a, b);
+    REQUIRE_NE(a, std::this_thread::get_id());
+  }
+
+  SUBCASE("Forks can follow other stages, and keep bounded policies") {
+    auto identity = [](int x) { return x; };
+    auto pipeline = tdp::input<int> >> tdp::parallel<2>(identity) >> tdp::fork{square, negate}
+                    >> tdp::output / tdp::policy::spsc_ring<4>;
+
+    std::thread feeder{[&] {
+      for (int i = 0; i < input_count; i++)
+        pipeline.input(i);
+    }};
+
+    auto outputs = pipeline.wait_get_n(input_count);
+    feeder.join();
+    std::sort(outputs.begin(), outputs.end(), [](auto& a, auto& b) { return std::get<1>(a) > std::get<1>(b); });
+    for (int i = 0; i < input_count; i++) {
+      REQUIRE_EQ(std::get<0>(outputs[i]), i * i);
+      REQUIRE_EQ(std::get<1>(outputs[i]), -i);
+    }
+  }
+
+  SUBCASE("Inputs with a timeout give up while a branch is full, without sending to the other branches") {
+    std::atomic_bool release = false;
+    std::atomic_bool started = false;
+    auto held = [&](int x) {
+      started = true;
+      const auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (!release && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      return x;
+    };
+
+    // Once the held branch is running, its queue can only fill up, while the first branch keeps taking inputs
+    auto check_full = [&](auto& pipeline) {
+      release = false;
+      started = false;
+      pipeline.input(0);
+      const auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (!started && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      REQUIRE(started);
+
+      int accepted = 1;
+      while (pipeline.input_for(100ms, accepted))
+        accepted++;
+      REQUIRE_FALSE(pipeline.try_input(accepted));
+
+      release = true;
+      REQUIRE(pipeline.input_for(5s, accepted));
+      auto outputs = pipeline.wait_get_n(accepted + 1);
+      for (int i = 0; i <= accepted; i++) {
+        REQUIRE_EQ(std::get<0>(outputs[i]), -i);
+        REQUIRE_EQ(std::get<1>(outputs[i]), i);
+      }
+    };
+
+    auto blocking = tdp::input<int> >> tdp::fork{negate, held} >> tdp::output / tdp::policy::bounded_queue<2>;
+    check_full(blocking);
+
+    auto lockfree = tdp::input<int> >> tdp::fork{negate, held} >> tdp::output / tdp::policy::spsc_ring<2>;
+    check_full(lockfree);
+  }
+
+  // The output keeps only the latest tuple, but its results must still come from the same input
+  auto check_latest = [&](auto& pipeline) {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    for (int last = 0; last != -(input_count - 1);) {
+      auto [a, b] = pipeline.wait_get();
+      REQUIRE_EQ(a, b * b);
+      REQUIRE_LT(b, last + 1);
+      last = b;
+    }
+  };
+
+  SUBCASE("Branches get the same inputs under triple-buffer policies") {
+    // The slower branch would drop more inputs than the other one
+    auto slow_square = [](int x) {
+      std::this_thread::sleep_for(std::chrono::microseconds(x % 3 * 50));
+      return x * x;
+    };
+    auto blocking = tdp::input<int> >> tdp::fork{slow_square, negate} >> tdp::output / tdp::policy::triple_buffer;
+    check_latest(blocking);
+
+    auto lockfree = tdp::input<int> >> tdp::fork{slow_square, negate}
+                    >> tdp::output / tdp::policy::triple_buffer_lockfree;
+    check_latest(lockfree);
+  }
+
+  SUBCASE("Forks of consumers, with many arguments") {
+    std::atomic_int sum = 0;
+    std::atomic_int product = 0;
+    auto pipeline = tdp::input<int, int> >> tdp::consumer{tdp::fork{
+                        [&](int a, int b) { sum += a + b; },
+                        [&](int a, int b) { product += a * b; },
+                    }};
+    pipeline.input(1, 2);
+    pipeline.input(3, 4);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while ((sum != 10 || product != 14) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(sum.load(), 10);
+    REQUIRE_EQ(product.load(), 14);
+  }
+}
+
+TEST_CASE("Routes") {
+  constexpr int input_count = 1000;
+  constexpr auto by_three = [](int x) { return x % 3; };
+  auto tag = [](int branch) { return [branch](int x) { return std::pair{branch, x}; }; };
+
+  // Inputs sent to the same branch keep their order
+  auto check_routed = [&](std::vector<std::pair<int, int>> outputs) {
+    REQUIRE_EQ(outputs.size(), input_count);
+    std::vector<int> last(3, -1);
+    for (auto [branch, x] : outputs) {
+      REQUIRE_EQ(branch, x % 3);
+      REQUIRE_LT(last[branch], x);
+      last[branch] = x;
+    }
+  };
+
+  SUBCASE("Each input is sent to the selected branch, and their results are merged") {
+    auto pipeline = tdp::input<int> >> tdp::route{by_three, tag(0), tag(1), tag(2)} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+    check_routed(pipeline.wait_get_n(input_count));
+  }
+
+  SUBCASE("Indexes past the last branch, or negative, select the last one") {
+    auto pipeline = tdp::input<int> >> tdp::route{[](int x) { return x; }, tag(0), tag(1)} >> tdp::output;
+    for (int i = -5; i < 5; i++)
+      pipeline.input(i);
+
+    for (auto [branch, x] : pipeline.wait_get_n(10))
+      REQUIRE_EQ(branch, x == 0 ? 0 : 1);
+
+    auto direct = tdp::route{[](int x) { return x; }, tag(0), tag(1)};
+    REQUIRE_EQ(direct(5).first, 1);
+    REQUIRE_EQ(direct(-1).first, 1);
+  }
+
+  SUBCASE("A slow branch doesn't delay the others") {
+    std::atomic_bool release = false;
+    auto slow = [&](int x) {
+      const auto deadline = std::chrono::steady_clock::now() + 5s;
+      while (!release && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+      return x;
+    };
+    auto pipeline = tdp::input<int> >> tdp::route{[](int x) { return x != 0; }, slow, [](int x) { return x; }}
+                    >> tdp::output / tdp::policy::spsc_ring<16>;
+    pipeline.input(0);
+    for (int i = 1; i < 10; i++)
+      pipeline.input(i);
+
+    const std::vector<int> expected{1, 2, 3, 4, 5, 6, 7, 8, 9};
+    REQUIRE_EQ(pipeline.wait_get_n(9), expected);
+    release = true;
+    REQUIRE_EQ(pipeline.wait_get(), 0);
+  }
+
+  SUBCASE("Routes can follow other stages, and their outputs can be tapped") {
+    std::atomic_int observed = -1;
+    auto pipeline = tdp::input<int> >> tdp::parallel<2>([](int x) { return x; })
+                    >> tdp::route{by_three, tdp::fuse{tag(0)}, tag(1), tag(2)}
+                    >> tdp::tap{[&](const std::pair<int, int>& p) { observed = p.second; }} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    // The parallel stage doesn't keep the input order, so only the branch of each input is checked
+    auto outputs = pipeline.wait_get_n(input_count);
+    std::sort(outputs.begin(), outputs.end(), [](auto& a, auto& b) { return a.second < b.second; });
+    for (int i = 0; i < input_count; i++) {
+      REQUIRE_EQ(outputs[i].second, i);
+      REQUIRE_EQ(outputs[i].first, i % 3);
+    }
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (observed < 0 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_LE(0, observed.load());
+  }
+
+  SUBCASE("Routes of consumers, with many arguments") {
+    std::atomic_int sum = 0;
+    std::atomic_int product = 0;
+    auto pipeline = tdp::input<int, int> >> tdp::consumer{tdp::route{
+                        [](int a, int) { return a; },
+                        [&](int a, int b) { sum += a + b; },
+                        [&](int a, int b) { product += a * b; },
+                    }};
+    pipeline.input(0, 2);
+    pipeline.input(1, 4);
+    pipeline.input(0, 5);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while ((sum != 7 || product != 4) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(sum.load(), 7);
+    REQUIRE_EQ(product.load(), 4);
+  }
+}
+
+TEST_CASE("Filter stages") {
+  constexpr int input_count = 1000;
+  constexpr auto is_even = [](int x) { return x % 2 == 0; };
+  constexpr auto half_if_even = [](int x) { return (x % 2 == 0) ? std::optional{x / 2} : std::nullopt; };
+
+  auto check_evens = [&](auto& pipeline, auto expected) {
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count / 2);
+    for (int i = 0; i < input_count / 2; i++)
+      REQUIRE_EQ(outputs[i], expected(2 * i));
+    REQUIRE_FALSE(pipeline.try_get());
+  };
+
+  SUBCASE("Only inputs passing the predicate are sent, in order") {
+    auto pipeline = tdp::input<int> >> tdp::filter{is_even} >> tdp::output;
+    check_evens(pipeline, [](int x) { return x; });
+  }
+
+  SUBCASE("Only engaged values are sent, unwrapped") {
+    auto pipeline = tdp::input<int> >> tdp::filter_map{half_if_even} >> [](int x) { return x + 1; } >> tdp::output;
+    static_assert(std::is_same_v<decltype(pipeline.wait_get()), int>);
+    check_evens(pipeline, [](int x) { return x / 2 + 1; });
+  }
+
+  SUBCASE("Inputs are moved, and the predicate only sees a const reference") {
+    auto non_empty = [](const std::string& s) { return !s.empty(); };
+    auto pipeline = tdp::input<std::string> >> tdp::filter{non_empty} >> tdp::output / tdp::policy::spsc_ring<4>;
+    for (const char* s : {"a", "", "b", "", "", "c"})
+      pipeline.input(s);
+
+    REQUIRE_EQ(pipeline.wait_get(), "a");
+    REQUIRE_EQ(pipeline.wait_get(), "b");
+    REQUIRE_EQ(pipeline.wait_get(), "c");
+  }
+
+  SUBCASE("Filters can be parallel, partitioned and fused") {
+    auto parallel = tdp::input<int> >> tdp::parallel<3>(tdp::filter{is_even}) >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      parallel.input(i);
+    std::vector<int> outputs = parallel.wait_get_n(input_count / 2);
+    std::sort(outputs.begin(), outputs.end());
+    for (int i = 0; i < input_count / 2; i++)
+      REQUIRE_EQ(outputs[i], 2 * i);
+
+    auto partitioned = tdp::input<int> >> tdp::partition<2>([](int x) { return x % 4; }, tdp::filter{is_even})
+                       >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      partitioned.input(i);
+    REQUIRE_EQ(partitioned.wait_get_n(input_count / 2).size(), input_count / 2);
+
+    auto triple = [](int x) { return x * 3; };
+    auto fused = tdp::input<int> >> tdp::fuse{triple, tdp::filter_map{half_if_even}} >> tdp::output;
+    check_evens(fused, [](int x) { return x * 3 / 2; });
+  }
+
+  SUBCASE("Filters can produce and consume") {
+    auto produced = tdp::producer{tdp::filter_map{[=, i = 0]() mutable { return half_if_even(i++); }}}
+                    >> tdp::output;
+    std::vector<int> outputs = produced.wait_get_n(10);
+    for (int i = 0; i < 10; i++)
+      REQUIRE_EQ(outputs[i], i);
+
+    std::atomic_int count = 0;
+    auto consumed = tdp::input<int> >> tdp::filter{is_even} >> tdp::consumer{[&](int) { count++; }};
+    for (int i = 0; i < input_count; i++)
+      consumed.input(i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (count < input_count / 2 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    std::this_thread::sleep_for(1ms);
+    REQUIRE_EQ(count, input_count / 2);
+  }
+}
+
+TEST_CASE("Flat-map stages") {
+  constexpr int input_count = 100;
+  constexpr auto repeat = [](int x) { return std::vector<int>(x % 4, x); };
+
+  // Each input x gives x % 4 copies of itself
+  auto check_repeated = [&](const std::vector<int>& outputs) {
+    std::size_t index = 0;
+    for (int i = 0; i < input_count; i++)
+      for (int n = 0; n < i % 4; n++)
+        REQUIRE_EQ(outputs[index++], i);
+    REQUIRE_EQ(index, outputs.size());
+  };
+  constexpr std::size_t output_count = input_count / 4 * (0 + 1 + 2 + 3);
+
+  SUBCASE("Each element of the range is sent, in order") {
+    auto pipeline = tdp::input<int> >> tdp::flat_map{repeat} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    check_repeated(pipeline.wait_get_n(output_count));
+    REQUIRE_FALSE(pipeline.try_get());
+  }
+
+  SUBCASE("Ranges larger than a bounded queue are sent as space becomes available") {
+    auto pipeline = tdp::input<int> >> tdp::flat_map{[](int x) { return std::vector<int>(100, x); }}
+                    >> [](int x) { return x + 1; } >> tdp::output / tdp::policy::spsc_ring<4>;
+    pipeline.input(1);
+    pipeline.input(2);
+
+    std::vector<int> outputs = pipeline.wait_get_n(200);
+    for (int i = 0; i < 200; i++)
+      REQUIRE_EQ(outputs[i], i / 100 + 2);
+  }
+
+  SUBCASE("Elements are moved to the next stage") {
+    auto words = [](const std::string& s) {
+      std::vector<std::string> result;
+      for (std::size_t begin = 0, end = 0; begin < s.size(); begin = end + 1) {
+        end = std::min(s.find(' ', begin), s.size());
+        result.push_back(s.substr(begin, end - begin));
+      }
+      return result;
+    };
+    auto pipeline = tdp::input<std::string> >> tdp::flat_map{words} >> tdp::output;
+    pipeline.input("The Darkest Pipeline");
+    pipeline.input("");
+    pipeline.input("TDP");
+
+    std::vector<std::string> outputs = pipeline.wait_get_n(4);
+    REQUIRE_EQ(outputs[0], "The");
+    REQUIRE_EQ(outputs[1], "Darkest");
+    REQUIRE_EQ(outputs[2], "Pipeline");
+    REQUIRE_EQ(outputs[3], "TDP");
+  }
+
+  SUBCASE("Flat-map stages can be parallel, fused and producers") {
+    auto parallel = tdp::input<int> >> tdp::parallel<3>(tdp::flat_map{repeat}) >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      parallel.input(i);
+    std::vector<int> outputs = parallel.wait_get_n(output_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(std::count(outputs.begin(), outputs.end(), i), i % 4);
+
+    auto fused = tdp::input<int> >> tdp::fuse{[](int x) { return x; }, tdp::flat_map{repeat}} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      fused.input(i);
+    check_repeated(fused.wait_get_n(output_count));
+
+    auto produced = tdp::producer{tdp::flat_map{[=, i = 0]() mutable { return repeat(i++); }}} >> tdp::output;
+    check_repeated(produced.wait_get_n(output_count));
+  }
+}
+
+TEST_CASE("Batch stages") {
+  constexpr int input_count = 100;
+
+  // Batches can be cut anywhere, but their elements must be every input, in order
+  auto check_batches = [&](const std::vector<std::vector<int>>& batches, std::size_t size) {
+    int next = 0;
+    for (auto& batch : batches) {
+      REQUIRE_LE(batch.size(), size);
+      for (int x : batch)
+        REQUIRE_EQ(x, next++);
+    }
+    REQUIRE_EQ(next, input_count);
+  };
+
+  SUBCASE("Full batches are sent without waiting for the delay") {
+    auto pipeline = tdp::input<int> >> tdp::batch<10>(1h) >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    auto batches = pipeline.wait_get_n(input_count / 10);
+    for (auto& batch : batches)
+      REQUIRE_EQ(batch.size(), 10);
+    check_batches(batches, 10);
+  }
+
+  SUBCASE("Partial batches are sent after the delay") {
+    auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::batch<10>(10ms) >> tdp::output;
+    const auto start = std::chrono::steady_clock::now();
+    pipeline.input(1);
+    pipeline.input(2);
+    pipeline.input(3);
+
+    const std::vector<int> expected{1, 2, 3};
+    REQUIRE_EQ(pipeline.wait_get(), expected);
+    REQUIRE_LE(10ms, std::chrono::steady_clock::now() - start);
+  }
+
+  SUBCASE("Batches can be split back") {
+    auto sum = [](std::vector<int> batch) {
+      std::partial_sum(batch.begin(), batch.end(), batch.begin());
+      return batch;
+    };
+    auto pipeline = tdp::input<int> >> tdp::batch<4>(1h) >> sum >> tdp::unbatch >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(1);
+
+    std::vector<int> outputs = pipeline.wait_get_n(input_count);
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(outputs[i], i % 4 + 1);
+  }
+
+  SUBCASE("Batch stages keep their delay on every policy") {
+    constexpr auto delay = 100us;
+    auto check_policy = [&](auto pipeline) {
+      std::thread feeder{[&] {
+        for (int i = 0; i < input_count; i++) {
+          pipeline->input(i);
+          if (i % 7 == 0)
+            std::this_thread::sleep_for(1ms);
+        }
+      }};
+
+      std::vector<std::vector<int>> batches;
+      for (std::size_t n = 0; n < input_count; n += batches.back().size())
+        batches.push_back(pipeline->wait_get());
+      feeder.join();
+      check_batches(batches, 8);
+
+      // A lone input waits for the delay before it's sent
+      const auto start = std::chrono::steady_clock::now();
+      pipeline->input(input_count);
+      REQUIRE_EQ(pipeline->wait_get(), std::vector<int>{input_count});
+      REQUIRE_LE(delay, std::chrono::steady_clock::now() - start);
+    };
+
+    using tdp::as_unique_ptr;
+    check_policy(tdp::input<int> >> tdp::batch<8>(delay) >> tdp::output / tdp::policy::queue / as_unique_ptr);
+    check_policy(
+        tdp::input<int> >> tdp::batch<8>(delay) >> tdp::output / tdp::policy::bounded_queue<4> / as_unique_ptr);
+    check_policy(tdp::input<int> >> tdp::batch<8>(delay) >> tdp::output / tdp::policy::spsc_ring<4> / as_unique_ptr);
+    check_policy(tdp::input<int> >> tdp::via(tdp::policy::spsc_unbounded) >> tdp::batch<8>(delay)
+                 >> tdp::output / tdp::as_unique_ptr);
+  }
+}
+
+TEST_CASE("Taps") {
+  constexpr int input_count = 1000;
+  std::vector<int> observed;
+  std::atomic_int last = -1;
+  auto observer = [&](int x) {
+    observed.push_back(x);
+    last = x;
+  };
+
+  SUBCASE("Outputs are sent unchanged, and the observer sees the latest ones, in order") {
+    auto pipeline = tdp::input<int> >> [](int x) { return x * 2; } >> tdp::tap{observer} >> [](int x) { return x + 1; }
+                    >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i * 2 + 1);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (last != (input_count - 1) * 2 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(last.load(), (input_count - 1) * 2);
+
+    REQUIRE(std::is_sorted(observed.begin(), observed.end()));
+    REQUIRE(std::adjacent_find(observed.begin(), observed.end()) == observed.end());
+  }
+
+  SUBCASE("A slow observer misses outputs, instead of holding the stage back") {
+    std::atomic_int calls = 0;
+    auto slow = [&](int) {
+      calls++;
+      std::this_thread::sleep_for(20ms);
+    };
+    auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::tap{slow} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+    REQUIRE_LT(calls, input_count / 10);
+  }
+
+  SUBCASE("Only one in N outputs is offered") {
+    auto pipeline = tdp::input<int> >> [](int x) { return x; } >> tdp::tap{observer, 10} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(pipeline.wait_get(), i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (last != input_count - 1 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(last.load(), input_count - 1);
+
+    for (int x : observed)
+      REQUIRE_EQ(x % 10, 9);
+  }
+
+  SUBCASE("Taps can follow producers, parallel and filter stages") {
+    std::atomic_int produced = 0;
+    auto producer = tdp::producer{[&] { return produced++; }} >> tdp::tap{observer} >> tdp::output;
+    for (int i = 0; i < input_count; i++)
+      REQUIRE_EQ(producer.wait_get(), i);
+
+    const auto deadline = std::chrono::steady_clock::now() + 5s;
+    while (last < input_count / 2 && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_LE(input_count / 2, last.load());
+    producer.pause();
+
+    std::atomic_int kept = -1, consumed = 0;
+    auto even = [](int x) { return x % 2 == 0; };
+    auto pipeline = tdp::input<int> >> tdp::parallel<2>(tdp::filter{even}) >> tdp::tap{[&](int x) { kept = x; }}
+                    >> tdp::consumer{[&](int) { consumed++; }};
+    for (int i = 0; i < input_count; i++)
+      pipeline.input(i);
+    while ((consumed < input_count / 2 || kept < 0) && std::chrono::steady_clock::now() < deadline)
+      std::this_thread::yield();
+    REQUIRE_EQ(consumed.load(), input_count / 2);
+    REQUIRE_LE(0, kept.load());
+    REQUIRE_EQ(kept % 2, 0);
+  }
+}